@@ -0,0 +1,474 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "bitmap_convert.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FONTDEBUG_HAS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const uint32_t kAlpha = 0xff000000;
+
+// Channel kept by each LCD subpixel, indexed by subpixel % 3
+const uint32_t kLcdMask[3] = { 0x00ff0000, 0x0000ff00, 0x000000ff };
+
+// Row kernels. Gray rows are also used for grayscale LCD and, with a
+// channel mask, for colored LCD_V rows where the whole row is one channel.
+struct RowKernels
+{
+    void (*gray)(const uint8_t *src, uint32_t *dst, int width, uint32_t mask);
+    void (*lcd)(const uint8_t *src, uint32_t *dst, int width);
+    void (*mono)(const uint8_t *src, uint32_t *dst, int width);
+    void (*bgra)(const uint8_t *src, uint32_t *dst, int width);
+};
+
+// Scalar reference kernels
+
+void grayRowScalar(const uint8_t *src, uint32_t *dst, int width, uint32_t mask)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        dst[x] = kAlpha | ((src[x] * 0x010101u) & mask);
+    }
+}
+
+// `phase` is the subpixel index of src[0] modulo 3, for finishing rows in SIMD kernels
+void lcdRowScalar(const uint8_t *src, uint32_t *dst, int width, int phase)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        dst[x] = kAlpha | ((src[x] * 0x010101u) & kLcdMask[(x + phase) % 3]);
+    }
+}
+
+void lcdRowScalar(const uint8_t *src, uint32_t *dst, int width)
+{
+    lcdRowScalar(src, dst, width, 0);
+}
+
+void monoRowScalar(const uint8_t *src, uint32_t *dst, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        bool set = src[x / 8] & (0x80 >> (x % 8));
+        dst[x] = set ? 0xffffffff : kAlpha;
+    }
+}
+
+void bgraRowScalar(const uint8_t *src, uint32_t *dst, int width)
+{
+    // Premultiplied BGRA has the same byte order as little endian ARGB32,
+    // dropping alpha gives the color over black.
+    for (int x = 0; x < width; ++x)
+    {
+        uint32_t px;
+        memcpy(&px, src + 4 * x, 4);
+        dst[x] = kAlpha | px;
+    }
+}
+
+const RowKernels kScalarKernels = { grayRowScalar, lcdRowScalar, monoRowScalar, bgraRowScalar };
+
+#ifdef FONTDEBUG_HAS_X86_KERNELS
+
+// SSE2 kernels, 16 source bytes per iteration
+
+__attribute__((target("sse2")))
+void grayRowSSE2(const uint8_t *src, uint32_t *dst, int width, uint32_t mask)
+{
+    const __m128i alpha = _mm_set1_epi32(kAlpha);
+    const __m128i m = _mm_set1_epi32(mask);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i lo = _mm_unpacklo_epi8(v, v);
+        __m128i hi = _mm_unpackhi_epi8(v, v);
+
+        __m128i *out = reinterpret_cast<__m128i*>(dst + x);
+        _mm_storeu_si128(out + 0, _mm_or_si128(alpha, _mm_and_si128(m, _mm_unpacklo_epi16(lo, lo))));
+        _mm_storeu_si128(out + 1, _mm_or_si128(alpha, _mm_and_si128(m, _mm_unpackhi_epi16(lo, lo))));
+        _mm_storeu_si128(out + 2, _mm_or_si128(alpha, _mm_and_si128(m, _mm_unpacklo_epi16(hi, hi))));
+        _mm_storeu_si128(out + 3, _mm_or_si128(alpha, _mm_and_si128(m, _mm_unpackhi_epi16(hi, hi))));
+    }
+    grayRowScalar(src + x, dst + x, width - x, mask);
+}
+
+__attribute__((target("sse2")))
+void lcdRowSSE2(const uint8_t *src, uint32_t *dst, int width)
+{
+    const __m128i alpha = _mm_set1_epi32(kAlpha);
+
+    // Masks for 4 pixels starting at subpixel phase 0, 1 and 2. Each 4 pixel
+    // store advances the phase by one.
+    const __m128i masks[3] = {
+        _mm_setr_epi32(kLcdMask[0], kLcdMask[1], kLcdMask[2], kLcdMask[0]),
+        _mm_setr_epi32(kLcdMask[1], kLcdMask[2], kLcdMask[0], kLcdMask[1]),
+        _mm_setr_epi32(kLcdMask[2], kLcdMask[0], kLcdMask[1], kLcdMask[2]),
+    };
+
+    int phase = 0;
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i lo = _mm_unpacklo_epi8(v, v);
+        __m128i hi = _mm_unpackhi_epi8(v, v);
+        __m128i px[4] = {
+            _mm_unpacklo_epi16(lo, lo),
+            _mm_unpackhi_epi16(lo, lo),
+            _mm_unpacklo_epi16(hi, hi),
+            _mm_unpackhi_epi16(hi, hi),
+        };
+
+        __m128i *out = reinterpret_cast<__m128i*>(dst + x);
+        for (int i = 0; i < 4; ++i)
+        {
+            _mm_storeu_si128(out + i, _mm_or_si128(alpha, _mm_and_si128(masks[phase], px[i])));
+            phase = phase == 2 ? 0 : phase + 1;
+        }
+    }
+    lcdRowScalar(src + x, dst + x, width - x, x % 3);
+}
+
+__attribute__((target("sse2")))
+void monoRowSSE2(const uint8_t *src, uint32_t *dst, int width)
+{
+    const __m128i alpha = _mm_set1_epi32(kAlpha);
+    const __m128i bits = _mm_setr_epi8(
+        (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+        (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        // Spread two source bytes over 8 lanes each, then test one bit per lane
+        __m128i v = _mm_set_epi8(
+            src[x/8 + 1], src[x/8 + 1], src[x/8 + 1], src[x/8 + 1],
+            src[x/8 + 1], src[x/8 + 1], src[x/8 + 1], src[x/8 + 1],
+            src[x/8], src[x/8], src[x/8], src[x/8],
+            src[x/8], src[x/8], src[x/8], src[x/8]);
+        __m128i gray = _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits);
+        __m128i lo = _mm_unpacklo_epi8(gray, gray);
+        __m128i hi = _mm_unpackhi_epi8(gray, gray);
+
+        __m128i *out = reinterpret_cast<__m128i*>(dst + x);
+        _mm_storeu_si128(out + 0, _mm_or_si128(alpha, _mm_unpacklo_epi16(lo, lo)));
+        _mm_storeu_si128(out + 1, _mm_or_si128(alpha, _mm_unpackhi_epi16(lo, lo)));
+        _mm_storeu_si128(out + 2, _mm_or_si128(alpha, _mm_unpacklo_epi16(hi, hi)));
+        _mm_storeu_si128(out + 3, _mm_or_si128(alpha, _mm_unpackhi_epi16(hi, hi)));
+    }
+    // x is a multiple of 8 here, so the rest starts on a byte boundary
+    monoRowScalar(src + x / 8, dst + x, width - x);
+}
+
+__attribute__((target("sse2")))
+void bgraRowSSE2(const uint8_t *src, uint32_t *dst, int width)
+{
+    const __m128i alpha = _mm_set1_epi32(kAlpha);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_or_si128(alpha, v));
+    }
+    bgraRowScalar(src + 4 * x, dst + x, width - x);
+}
+
+const RowKernels kSSE2Kernels = { grayRowSSE2, lcdRowSSE2, monoRowSSE2, bgraRowSSE2 };
+
+// AVX2 kernels, 8 output pixels per vector
+
+__attribute__((target("avx2")))
+inline __m256i expandGray8AVX2(const uint8_t *src)
+{
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+    return _mm256_mullo_epi32(_mm256_cvtepu8_epi32(v), _mm256_set1_epi32(0x010101));
+}
+
+__attribute__((target("avx2")))
+void grayRowAVX2(const uint8_t *src, uint32_t *dst, int width, uint32_t mask)
+{
+    const __m256i alpha = _mm256_set1_epi32(kAlpha);
+    const __m256i m = _mm256_set1_epi32(mask);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i px = expandGray8AVX2(src + x);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_or_si256(alpha, _mm256_and_si256(m, px)));
+    }
+    grayRowScalar(src + x, dst + x, width - x, mask);
+}
+
+__attribute__((target("avx2")))
+void lcdRowAVX2(const uint8_t *src, uint32_t *dst, int width)
+{
+    const __m256i alpha = _mm256_set1_epi32(kAlpha);
+
+    // Masks for 8 pixels starting at subpixel phase 0, 1 and 2. Each 8 pixel
+    // store advances the phase by two.
+    const uint32_t r = kLcdMask[0], g = kLcdMask[1], b = kLcdMask[2];
+    const __m256i masks[3] = {
+        _mm256_setr_epi32(r, g, b, r, g, b, r, g),
+        _mm256_setr_epi32(g, b, r, g, b, r, g, b),
+        _mm256_setr_epi32(b, r, g, b, r, g, b, r),
+    };
+
+    int phase = 0;
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i px = expandGray8AVX2(src + x);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_or_si256(alpha, _mm256_and_si256(masks[phase], px)));
+        phase = (phase + 2) % 3;
+    }
+    lcdRowScalar(src + x, dst + x, width - x, x % 3);
+}
+
+__attribute__((target("avx2")))
+void monoRowAVX2(const uint8_t *src, uint32_t *dst, int width)
+{
+    const __m256i alpha = _mm256_set1_epi32(kAlpha);
+    const __m256i bits = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i v = _mm256_and_si256(_mm256_set1_epi32(src[x / 8]), bits);
+        __m256i px = _mm256_cmpeq_epi32(v, bits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_or_si256(alpha, px));
+    }
+    monoRowScalar(src + x / 8, dst + x, width - x);
+}
+
+__attribute__((target("avx2")))
+void bgraRowAVX2(const uint8_t *src, uint32_t *dst, int width)
+{
+    const __m256i alpha = _mm256_set1_epi32(kAlpha);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * x));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_or_si256(alpha, v));
+    }
+    bgraRowScalar(src + 4 * x, dst + x, width - x);
+}
+
+const RowKernels kAVX2Kernels = { grayRowAVX2, lcdRowAVX2, monoRowAVX2, bgraRowAVX2 };
+
+#endif // FONTDEBUG_HAS_X86_KERNELS
+
+const RowKernels& kernelsFor(BitmapConvertImpl impl)
+{
+    switch (impl)
+    {
+#ifdef FONTDEBUG_HAS_X86_KERNELS
+    case BitmapConvertImpl::SSE2: return kSSE2Kernels;
+    case BitmapConvertImpl::AVX2: return kAVX2Kernels;
+#endif
+    default: return kScalarKernels;
+    }
+}
+
+BitmapConvertImpl detectBitmapConvertImpl()
+{
+    // Allow forcing a slower implementation, for comparing them
+    const char *forced = getenv("FONTDEBUG_BITMAP_CONVERT");
+    if (forced)
+    {
+        for (BitmapConvertImpl impl : { BitmapConvertImpl::Scalar, BitmapConvertImpl::SSE2, BitmapConvertImpl::AVX2 })
+        {
+            if (strcmp(forced, bitmapConvertImplName(impl)) == 0 && bitmapConvertImplSupported(impl))
+            {
+                return impl;
+            }
+        }
+        std::cerr << "Ignoring unsupported FONTDEBUG_BITMAP_CONVERT=" << forced << "\n";
+    }
+
+    if (bitmapConvertImplSupported(BitmapConvertImpl::AVX2)) return BitmapConvertImpl::AVX2;
+    if (bitmapConvertImplSupported(BitmapConvertImpl::SSE2)) return BitmapConvertImpl::SSE2;
+    return BitmapConvertImpl::Scalar;
+}
+
+}
+
+BitmapConvertImpl bestBitmapConvertImpl()
+{
+    static const BitmapConvertImpl impl = detectBitmapConvertImpl();
+    return impl;
+}
+
+bool bitmapConvertImplSupported(BitmapConvertImpl impl)
+{
+    switch (impl)
+    {
+    case BitmapConvertImpl::Scalar: return true;
+#ifdef FONTDEBUG_HAS_X86_KERNELS
+    case BitmapConvertImpl::SSE2: return __builtin_cpu_supports("sse2");
+    case BitmapConvertImpl::AVX2: return __builtin_cpu_supports("avx2");
+#endif
+    default: return false;
+    }
+}
+
+const char* bitmapConvertImplName(BitmapConvertImpl impl)
+{
+    switch (impl)
+    {
+    case BitmapConvertImpl::Scalar: return "scalar";
+    case BitmapConvertImpl::SSE2:   return "sse2";
+    case BitmapConvertImpl::AVX2:   return "avx2";
+    default: return "???";
+    }
+}
+
+bool bitmapConvertSupported(const FT_Bitmap &bitmap)
+{
+    switch (bitmap.pixel_mode)
+    {
+    case FT_PIXEL_MODE_MONO:
+    case FT_PIXEL_MODE_GRAY:
+    case FT_PIXEL_MODE_LCD:
+    case FT_PIXEL_MODE_LCD_V:
+    case FT_PIXEL_MODE_BGRA:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void convertBitmap(const FT_Bitmap &bitmap, bool grayscaleLCD, uint32_t *dst, ptrdiff_t dstStride)
+{
+    convertBitmap(bitmap, grayscaleLCD, dst, dstStride, bestBitmapConvertImpl());
+}
+
+void convertBitmap(const FT_Bitmap &bitmap, bool grayscaleLCD, uint32_t *dst, ptrdiff_t dstStride, BitmapConvertImpl impl)
+{
+    const RowKernels &k = kernelsFor(impl);
+    int width = bitmap.width;
+
+    for (int y = 0; y < (int)bitmap.rows; ++y)
+    {
+        const uint8_t *src = bitmapRow(bitmap, y);
+        uint32_t *out = reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(dst) + y * dstStride);
+
+        switch (bitmap.pixel_mode)
+        {
+        case FT_PIXEL_MODE_MONO:
+            k.mono(src, out, width);
+            break;
+        case FT_PIXEL_MODE_GRAY:
+            k.gray(src, out, width, 0x00ffffff);
+            break;
+        case FT_PIXEL_MODE_LCD:
+            if (grayscaleLCD) k.gray(src, out, width, 0x00ffffff);
+            else              k.lcd(src, out, width);
+            break;
+        case FT_PIXEL_MODE_LCD_V:
+            k.gray(src, out, width, grayscaleLCD ? 0x00ffffff : kLcdMask[y % 3]);
+            break;
+        case FT_PIXEL_MODE_BGRA:
+            k.bgra(src, out, width);
+            break;
+        default:
+            memset(out, 0, width * sizeof(uint32_t));
+            break;
+        }
+    }
+}
+
+bool bitmapGeometry(const FT_Bitmap &bitmap, BitmapGeometry &geometry)
+{
+    if (!bitmapConvertSupported(bitmap)) return false;
+
+    geometry.width = bitmap.width;
+    geometry.height = bitmap.rows;
+    geometry.columnWidth = 1.0;
+    geometry.rowHeight = 1.0;
+
+    if (bitmap.pixel_mode == FT_PIXEL_MODE_LCD)
+    {
+        geometry.width /= 3;
+        geometry.columnWidth /= 3;
+    }
+    else if (bitmap.pixel_mode == FT_PIXEL_MODE_LCD_V)
+    {
+        geometry.height /= 3;
+        geometry.rowHeight /= 3;
+    }
+    return true;
+}
+
+uint32_t bitmapPixelColor(const FT_Bitmap &bitmap, int x, int y)
+{
+    uint32_t red   = 0;
+    uint32_t green = 0;
+    uint32_t blue  = 0;
+    uint32_t alpha = 255;
+
+    switch (bitmap.pixel_mode)
+    {
+    case FT_PIXEL_MODE_LCD:
+    {
+        red   = bitmapRow(bitmap, y)[3*x+0];
+        green = bitmapRow(bitmap, y)[3*x+1];
+        blue  = bitmapRow(bitmap, y)[3*x+2];
+        break;
+    }
+    case FT_PIXEL_MODE_LCD_V:
+    {
+        red   = bitmapRow(bitmap, 3*y+0)[x];
+        green = bitmapRow(bitmap, 3*y+1)[x];
+        blue  = bitmapRow(bitmap, 3*y+2)[x];
+        break;
+    }
+    case FT_PIXEL_MODE_GRAY:
+    {
+        red = green = blue = bitmapRow(bitmap, y)[x];
+        break;
+    }
+    case FT_PIXEL_MODE_MONO:
+    {
+        uint32_t byte = bitmapRow(bitmap, y)[x/8];
+        byte &= (((uint32_t)1) << (7-(x%8)));
+        red = green = blue = byte ? 255 : 0;
+        break;
+    }
+    case FT_PIXEL_MODE_BGRA:
+    {
+        red   = bitmapRow(bitmap, y)[4*x+2];
+        green = bitmapRow(bitmap, y)[4*x+1];
+        blue  = bitmapRow(bitmap, y)[4*x+0];
+        alpha = bitmapRow(bitmap, y)[4*x+3];
+        break;
+    }
+    }
+
+    return (red << 24) | (green << 16) | (blue << 8) | alpha;
+}
@@ -0,0 +1,75 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <freetype/freetype.h>
+
+enum class BitmapConvertImpl
+{
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+// Best implementation supported by the running CPU, detected once
+BitmapConvertImpl bestBitmapConvertImpl();
+bool bitmapConvertImplSupported(BitmapConvertImpl impl);
+const char* bitmapConvertImplName(BitmapConvertImpl impl);
+
+// Returns true for pixel modes convertBitmap() can handle
+bool bitmapConvertSupported(const FT_Bitmap &bitmap);
+
+// Converts `bitmap` to opaque 0xAARRGGBB pixels as they appear on a black
+// background. Each LCD subpixel becomes one output pixel, so the output is
+// bitmap.width x bitmap.rows pixels for every mode. Output rows are
+// `dstStride` bytes apart.
+void convertBitmap(const FT_Bitmap &bitmap, bool grayscaleLCD, uint32_t *dst, ptrdiff_t dstStride);
+void convertBitmap(const FT_Bitmap &bitmap, bool grayscaleLCD, uint32_t *dst, ptrdiff_t dstStride, BitmapConvertImpl impl);
+
+// Layout of a bitmap in whole pixels. LCD bitmaps have three subpixel
+// columns (LCD_V: rows) per pixel.
+struct BitmapGeometry
+{
+    // In pixels
+    int width;
+    int height;
+    // Size of one bitmap column and row, in pixels
+    double columnWidth;
+    double rowHeight;
+};
+
+// Returns false for pixel modes convertBitmap() can't handle
+bool bitmapGeometry(const FT_Bitmap &bitmap, BitmapGeometry &geometry);
+
+// Color of pixel (x, y) as 0xRRGGBBAA, with the subpixels of LCD bitmaps
+// as the channels. (x, y) must be inside bitmapGeometry()'s size.
+uint32_t bitmapPixelColor(const FT_Bitmap &bitmap, int x, int y);
+
+// Start of row `y` (counted from the top) of the bitmap, honoring negative pitch
+inline const uint8_t* bitmapRow(const FT_Bitmap &bitmap, int y)
+{
+    if (bitmap.pitch >= 0)
+    {
+        return bitmap.buffer + (ptrdiff_t)y * bitmap.pitch;
+    }
+    // Negative pitch means the buffer starts with the bottom row
+    return bitmap.buffer + (ptrdiff_t)(bitmap.rows - 1 - y) * -bitmap.pitch;
+}
@@ -17,15 +17,53 @@
 
 #pragma once
 
+#include "face_cache.hpp"
+#include "glyph_cache.hpp"
+#include "render.hpp"
+#include "result_cache.hpp"
+#include "trace.hpp"
+
+#include <cstdint>
+#include <utility>
+
 #include <glibmm/main.h>
 #include <freetype/freetype.h>
 #include <gtkmm/widget.h>
 #include <cairomm/context.h>
 
+// Counters shown in the properties panel
+struct Stats
+{
+    uint64_t rendersPosted = 0;
+    // font_redraw() calls folded into an already scheduled render
+    uint64_t rendersCoalesced = 0;
+    // Snapshots from the render worker
+    FaceCacheStats faceCache;
+    GlyphCacheStats glyphCache;
+    ResultCacheStats resultCache;
+};
+
+// sigc::signal whose emissions are traced under `name`
+template <typename T>
+struct TracedSignal : sigc::signal<T>
+{
+    explicit TracedSignal(const char *name) : m_name(name) {}
+
+    template <typename... Args>
+    void emit(Args&&... args)
+    {
+        TRACE_SCOPE("signal", m_name);
+        sigc::signal<T>::emit(std::forward<Args>(args)...);
+    }
+
+    const char *m_name;
+};
+
 struct Signals {
-    sigc::signal<void(FT_Face)> font_reloaded;
-    sigc::signal<void(Cairo::Matrix)> glyph_transform_updated;
-    sigc::signal<void(int, uint32_t)> pixel_selected;
+    TracedSignal<void(const RenderedGlyph&)> font_reloaded{"font_reloaded"};
+    TracedSignal<void(const Stats&)> stats_updated{"stats_updated"};
+    TracedSignal<void(Cairo::Matrix)> glyph_transform_updated{"glyph_transform_updated"};
+    TracedSignal<void(int, uint32_t)> pixel_selected{"pixel_selected"};
 };
 
 Gtk::Widget& makePropertiesWidget(Signals &);
@@ -17,49 +17,183 @@
 
 #include "drawer.hpp"
 
+#include "bitmap_convert.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
 
 #include <glibmm/main.h>
 
+#include <gdkmm/frameclock.h>
+
 #include <gtkmm/checkbutton.h>
 #include <gtkmm/drawingarea.h>
 #include <gtkmm/label.h>
 
-#include <freetype/ftoutln.h>
+
+void FreetypeBitmapDrawer::setGlyph(RenderedGlyphPtr glyph)
+{
+    // Cached results come back as the same glyph, its surface and tiles still hold
+    if (glyph == m_glyph) return;
+
+    m_glyph = glyph;
+    m_painter.setGlyph(std::move(glyph));
+    m_tiles.clear();
+}
+
+void FreetypeBitmapDrawer::setTimingOverlay(bool enabled)
+{
+    m_timingOverlay = enabled;
+    m_renderTimings = {};
+    m_fanOutTime = 0;
+    m_frameTimeHistory.clear();
+    queue_draw();
+}
+
+void FreetypeBitmapDrawer::setRenderTimings(const RenderTimings &timings, double fanOutTime)
+{
+    m_renderTimings = timings;
+    m_fanOutTime = fanOutTime;
+    queue_draw();
+}
+
+// Side of the square screen-space tiles the magnified view is cached in
+static const int kTileSize = 256;
+
+// Zoom per wheel step, as the log of the scale factor
+static const double kZoomStep = std::log(1.1);
+// Time constant the zoom eases towards its target with, in seconds
+static const double kZoomSmoothing = 0.06;
+// How long a touchpad zoom coasts after the fingers lift, in seconds
+static const double kZoomKineticTime = 0.2;
+
+// Frames shown in the timing overlay's graph
+static const size_t kFrameHistorySize = 120;
+// Frame time the graph marks, one frame at 60 Hz
+static const double kFrameBudget = 1000.0 / 60;
+
+bool FreetypeBitmapDrawer::TileKey::operator==(const TileKey &o) const
+{
+    return std::tie(glyph, xx, yx, xy, yy, x0, y0, grayscaleLCD, baseline, grid, outline, perPixel, horizontal)
+        == std::tie(o.glyph, o.xx, o.yx, o.xy, o.yy, o.x0, o.y0, o.grayscaleLCD, o.baseline, o.grid, o.outline, o.perPixel, o.horizontal);
+}
+
+void FreetypeBitmapDrawer::drawTiles(const Cairo::RefPtr<Cairo::Context>& cr, const Cairo::Matrix &viewMatrix)
+{
+    TRACE_SCOPE("draw", "drawTiles");
+
+    // Tiles sit on the device pixel grid. The integer part of the view translation is applied
+    // when compositing and only the fractional part is baked into the tiles, so panning by
+    // whole pixels reuses every tile that stays on screen.
+    double originX = floor(viewMatrix.x0);
+    double originY = floor(viewMatrix.y0);
+    Cairo::Matrix tileMatrix = viewMatrix;
+    tileMatrix.x0 -= originX;
+    tileMatrix.y0 -= originY;
+
+    PaintOptions options;
+    options.grayscaleLCD = m_drawGrayscaleLCD;
+    options.baseline = m_drawBaseline;
+    options.grid = m_drawGrid;
+    options.outline = m_drawOutline;
+    options.perPixel = m_drawPerPixel;
+    options.horizontal = m_isHorizontal;
+
+    PaintTimings *paintTimings = m_timingOverlay ? &m_frameTimings.paint : nullptr;
+
+    TileKey key = {
+        m_glyph.get(),
+        tileMatrix.xx, tileMatrix.yx, tileMatrix.xy, tileMatrix.yy, tileMatrix.x0, tileMatrix.y0,
+        m_drawGrayscaleLCD, m_drawBaseline, m_drawGrid, m_drawOutline, m_drawPerPixel, m_isHorizontal,
+    };
+    if (!(key == m_tileKey))
+    {
+        m_tiles.clear();
+        m_tileKey = key;
+    }
+
+    int tx1 = floor(-originX / kTileSize);
+    int ty1 = floor(-originY / kTileSize);
+    int tx2 = floor((lastWidth - 1 - originX) / kTileSize);
+    int ty2 = floor((lastHeight - 1 - originY) / kTileSize);
+
+    for (int ty = ty1; ty <= ty2; ++ty)
+    {
+        for (int tx = tx1; tx <= tx2; ++tx)
+        {
+            auto &tile = m_tiles[{ tx, ty }];
+            if (!tile)
+            {
+                TRACE_SCOPE("draw", "paint tile");
+                tile = Cairo::Surface::create(cr->get_target(), Cairo::CONTENT_COLOR, kTileSize, kTileSize);
+
+                Cairo::Matrix m = tileMatrix * Cairo::translation_matrix(-tx * kTileSize, -ty * kTileSize);
+                auto tileCr = Cairo::Context::create(tile);
+                tileCr->transform(m);
+                m_painter.drawScene(tileCr, m_painter.visiblePixels(m, kTileSize, kTileSize), options, paintTimings);
+                if (paintTimings) ++m_frameTimings.tilesRendered;
+            }
+
+            double x = originX + tx * kTileSize;
+            double y = originY + ty * kTileSize;
+            cr->set_source(tile, x, y);
+            cr->rectangle(x, y, kTileSize, kTileSize);
+            cr->fill();
+        }
+    }
+
+    // Drop tiles that scrolled away once they outnumber the visible ones
+    size_t visibleTiles = (size_t)(tx2 - tx1 + 1) * (ty2 - ty1 + 1);
+    if (m_tiles.size() > 2 * visibleTiles)
+    {
+        for (auto it = m_tiles.begin(); it != m_tiles.end(); )
+        {
+            auto [tx, ty] = it->first;
+            if (tx < tx1 - 1 || tx > tx2 + 1 || ty < ty1 - 1 || ty > ty2 + 1)
+            {
+                it = m_tiles.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+}
 
 bool FreetypeBitmapDrawer::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
 {
+    TRACE_SCOPE("draw", "on_draw");
+    auto frameStart = std::chrono::steady_clock::now();
+
     Gtk::Allocation allocation = get_allocation();
     lastWidth = allocation.get_width();
     lastHeight = allocation.get_height();
 
-    int pitch = m_face->glyph->bitmap.pitch;
-
-    auto &bitmap = m_face->glyph->bitmap;
+    if (!m_glyph)
+    {
+        cr->set_source_rgba(0, 0, 0, 1);
+        cr->paint();
+        return true;
+    }
 
-    double pixelWidth = 1.0;
-    double pixelHeight = 1.0;
-    int bitmapWidth = bitmap.width;
-    int bitmapHeight = bitmap.rows;
+    auto &bitmap = m_glyph->bitmap;
 
-    switch (bitmap.pixel_mode)
+    if (!m_painter.drawable())
     {
-    case FT_PIXEL_MODE_LCD:
-        pixelWidth /= 3;
-        bitmapWidth /= 3;
-        break;
-    case FT_PIXEL_MODE_LCD_V:
-        pixelHeight /= 3;
-        bitmapHeight /= 3;
-        break;
-    case FT_PIXEL_MODE_GRAY:
-    case FT_PIXEL_MODE_MONO:
-    case FT_PIXEL_MODE_BGRA:
-        break;
-    default:
         std::cerr << "Unhandled pixel mode: " << (int)bitmap.pixel_mode << "\n";
         return true;
-    };
+    }
+    const BitmapGeometry &geometry = m_painter.geometry();
+    int bitmapWidth = geometry.width;
+    int bitmapHeight = geometry.height;
 
     if (!m_transformMatrixInitialized)
     {
@@ -78,342 +212,243 @@ bool FreetypeBitmapDrawer::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
             m_transformMatrix = Cairo::identity_matrix();
             m_transformMatrix.scale(scale, scale);
             m_transformMatrix.translate(
-                -m_face->glyph->bitmap_left -bitmapWidth / 2.0,
-                m_face->glyph->bitmap_top - bitmapHeight / 2.0);
+                -m_glyph->bitmap_left -bitmapWidth / 2.0,
+                m_glyph->bitmap_top - bitmapHeight / 2.0);
         }
     }
 
-    cr->transform(m_transformMatrix * Cairo::translation_matrix(lastWidth * 0.5, lastHeight * 0.5));
-    cr->set_line_width(0.1);
-
-    cr->save();
-    cr->set_source_rgba(0, 0, 0, 1);
-    cr->paint();
-    cr->restore();
+    std::chrono::steady_clock::time_point lap;
+    if (m_timingOverlay)
+    {
+        m_frameTimings = {};
+        lap = std::chrono::steady_clock::now();
+    }
 
-    cr->save();
-    cr->translate(m_face->glyph->bitmap_left, -m_face->glyph->bitmap_top);
+    Cairo::Matrix viewMatrix = m_transformMatrix * Cairo::translation_matrix(lastWidth * 0.5, lastHeight * 0.5);
+    drawTiles(cr, viewMatrix);
+    if (m_timingOverlay) addLapTime(lap, m_frameTimings.tiles);
 
-    for (int y = 0; y < bitmap.rows; ++y)
+    // Overlays that change without the view changing are drawn on top of the tiles
     {
-        const uint8_t *row_buf = bitmap.buffer + y * bitmap.pitch;
+        TRACE_SCOPE("draw", "overlays");
+        cr->save();
+        cr->transform(viewMatrix);
+        cr->set_line_width(0.1);
 
-        if (bitmap.pixel_mode == FT_PIXEL_MODE_BGRA)
+        if (pointSelected)
         {
-            for (int x = 0; x < bitmap.width; ++x)
-            {
-                double b = row_buf[x*4 + 0] / 255.0;
-                double g = row_buf[x*4 + 1] / 255.0;
-                double r = row_buf[x*4 + 2] / 255.0;
-                double a = row_buf[x*4 + 3] / 255.0;
-
-                // Make pixels overlap a bit to get rid of rendering artifacts
-                double overlap = 0.01;
-                cr->set_source_rgb(r, g, b);
-                cr->move_to(-overlap + pixelWidth * x, -overlap + pixelHeight * y);
-                cr->rel_line_to(0, pixelHeight + 2*overlap);
-                cr->rel_line_to(pixelWidth + 2*overlap, 0);
-                cr->rel_line_to(0, -pixelHeight - 2*overlap);
-                cr->fill();
-            }
-        }
-        else
-        {
-            for (int x = 0; x < bitmap.width; ++x)
+            cr->save();
+            cr->translate(selX, selY);
+
+            cr->set_source_rgb(0.0, 1.0, 0.0);
+            cr->move_to(0, 0);
+            cr->line_to(1, 0);
+            cr->line_to(1, 1);
+            cr->line_to(0, 1);
+            cr->close_path();
+            cr->stroke();
+
+            cr->restore();
+
+            if (pointSignalEmitted == false)
             {
-                double gray = 0;
+                int imgX = selX - m_glyph->bitmap_left;
+                int imgY = selY + m_glyph->bitmap_top;
 
-                double r, g, b;
-                if (bitmap.pixel_mode == FT_PIXEL_MODE_MONO)
+                if (imgY < 0 || imgY >= bitmapHeight || imgX < 0 || imgX >= bitmapWidth)
                 {
-                    uint32_t byte = row_buf[x/8];
-                    byte &= (((uint32_t)1) << (7-(x%8)));
-                    gray = byte ? 1.0 : 0.0;
-                    r = b = g= gray;
+                    m_signals.pixel_selected.emit(0, 0);
                 }
                 else
                 {
-                    gray = row_buf[x] / 255.0;
-                    if (bitmap.pixel_mode == FT_PIXEL_MODE_GRAY || m_drawGrayscaleLCD)
-                    {
-                        r = g = b = gray;
-                    }
-                    else if (bitmap.pixel_mode == FT_PIXEL_MODE_LCD)
-                    {
-                        r = (x % 3 == 0) * gray;
-                        g = (x % 3 == 1) * gray;
-                        b = (x % 3 == 2) * gray;
-                    }
-                    else if (bitmap.pixel_mode == FT_PIXEL_MODE_LCD_V)
-                    {
-                        r = (y % 3 == 0) * gray;
-                        g = (y % 3 == 1) * gray;
-                        b = (y % 3 == 2) * gray;
-                    }
+                    m_signals.pixel_selected.emit(1, bitmapPixelColor(bitmap, imgX, imgY));
                 }
 
-                double overlap = 0.01;
-                cr->set_source_rgb(r, g, b);
-                cr->move_to(-overlap + pixelWidth * x, -overlap + pixelHeight * y);
-                cr->rel_line_to(0, pixelHeight + 2*overlap);
-                cr->rel_line_to(pixelWidth + 2*overlap, 0);
-                cr->rel_line_to(0, -pixelHeight - 2*overlap);
-                cr->fill();
+                pointSignalEmitted = true;
             }
         }
+        cr->restore();
     }
-    cr->restore();
 
-    if (m_drawGrid)
+    if (m_timingOverlay)
     {
-        int extend = 10;
-        double x1 = 0 - extend;
-        double y1 = 0 - extend;
-        double x2 = bitmapWidth + extend;
-        double y2 = bitmapHeight + extend;
+        addLapTime(lap, m_frameTimings.overlays);
+        auto since = frameStart;
+        addLapTime(since, m_frameTimings.total);
 
-        cr->save();
-        cr->set_source_rgb(0.15, 0.15, 0.15);
-        cr->translate(m_face->glyph->bitmap_left, -m_face->glyph->bitmap_top);
-
-        for (int i = x1; i <= x2; ++i)
+        m_frameTimeHistory.push_back(m_frameTimings.total);
+        if (m_frameTimeHistory.size() > kFrameHistorySize)
         {
-            cr->move_to(i, y1);
-            cr->line_to(i, y2);
+            m_frameTimeHistory.pop_front();
         }
-        for (int i = y1; i <= y2; ++i)
-        {
-            cr->move_to(x1, i);
-            cr->line_to(x2, i);
-        }
-        cr->stroke();
-        cr->restore();
+        drawTimingOverlay(cr);
     }
 
+    if (m_logFrameTimes)
     {
-        double x1 = 0;
-        double y1 = 0;
-        double x2 = bitmapWidth;
-        double y2 = bitmapHeight;
-        cr->save();
-        cr->translate(m_face->glyph->bitmap_left, -m_face->glyph->bitmap_top);
-
-        cr->set_source_rgb(0.4, 0.4, 0.4);
-        cr->move_to(x1, y1);
-        cr->line_to(x2, y1);
-        cr->line_to(x2, y2);
-        cr->line_to(x1, y2);
-        cr->close_path();
-        cr->stroke();
-
-        cr->restore();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - frameStart;
+        std::cerr << "Frame drawn in " << elapsed.count() << " ms ("
+                  << (m_drawPerPixel ? "per-pixel" : "image") << ", "
+                  << bitmap.width << "x" << bitmap.rows << " bitmap)\n";
     }
 
-    if (m_drawOutline)
-    {
-        FT_Outline &outline = m_face->glyph->outline;
-        if (outline.n_points)
-        {
-            cr->save();
-            cr->set_source_rgb(45.0/255, 206.0/255, 160.0/255);
-
-            bool path_open = true;
-
-            struct UserData
-            {
-                const Cairo::RefPtr<Cairo::Context>* cr;
-                std::function<void()> close_current_path;
-            };
+    return true;
+}
 
-            FT_Outline_Funcs funcs;
-            funcs.move_to = [](const FT_Vector *to, void *user_) -> int
-            {
-                UserData *user = reinterpret_cast<UserData*>(user_);
-
-                user->close_current_path();
-                const Cairo::RefPtr<Cairo::Context> &cr = *user->cr;
-                cr->move_to(to->x / 64.0, -to->y / 64.0);
-                return 0;
-            };
-            funcs.line_to = [](const FT_Vector *to, void *user_) -> int
-            {
-                UserData *user = reinterpret_cast<UserData*>(user_);
+void FreetypeBitmapDrawer::drawTimingOverlay(const Cairo::RefPtr<Cairo::Context>& cr)
+{
+    TRACE_SCOPE("draw", "drawTimingOverlay");
 
-                const Cairo::RefPtr<Cairo::Context> &cr = *user->cr;
-                cr->line_to(to->x / 64.0, -to->y / 64.0);
-                return 0;
-            };
-            funcs.conic_to = [](const FT_Vector *control, const FT_Vector *to, void *user_) -> int
-            {
-                UserData *user = reinterpret_cast<UserData*>(user_);
-
-                const Cairo::RefPtr<Cairo::Context> &cr = *user->cr;
-
-                // Elevate degree to use with cubic cairo curve fn
-                // Adapted from https://lists.cairographics.org/archives/cairo/2010-April/019691.html
-
-                double x0, y0;
-                cr->get_current_point(x0, y0);
-                double x1 = control->x / 64.0;
-                double y1 = -control->y / 64.0;
-                double x2 = to->x / 64.0;
-                double y2 = -to->y / 64.0;
-
-                cr->curve_to(
-                  2.0 / 3.0 * x1 + 1.0 / 3.0 * x0,
-                  2.0 / 3.0 * y1 + 1.0 / 3.0 * y0,
-                  2.0 / 3.0 * x1 + 1.0 / 3.0 * x2,
-                  2.0 / 3.0 * y1 + 1.0 / 3.0 * y2,
-                  x2, y2);
-
-                return 0;
-            };
-            funcs.cubic_to = [](const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to, void *user_) -> int
-            {
-                UserData *user = reinterpret_cast<UserData*>(user_);
+    const FrameTimings &f = m_frameTimings;
+    const RenderTimings &r = m_renderTimings;
 
-                const Cairo::RefPtr<Cairo::Context> &cr = *user->cr;
-                cr->curve_to(control1->x / 64.0, -control1->y / 64.0, control2->x / 64.0, -control2->y / 64.0, to->x / 64.0, -to->y / 64.0);
-                return 0;
-            };
-            funcs.shift = 0;
-            funcs.delta = 0;
+    std::vector<std::string> lines;
+    char buf[200];
+    auto line = [&](const char *format, auto... args)
+    {
+        snprintf(buf, sizeof(buf), format, args...);
+        lines.push_back(buf);
+    };
 
+    line("%-18s%7.2f ms", "Frame", f.total);
+    line("%-18s%7.2f ms, %d rendered", "  tiles", f.tiles, f.tilesRendered);
+    line("%-18s%7.2f ms", "    bitmap", f.paint.bitmap);
+    line("%-18s%7.2f ms", "    grid", f.paint.grid);
+    line("%-18s%7.2f ms", "    outline", f.paint.outline);
+    line("%-18s%7.2f ms", "    baseline", f.paint.baseline);
+    line("%-18s%7.2f ms", "  overlays", f.overlays);
+    if (r.cached)
+    {
+        line("%-18sfrom result cache", "Render");
+    }
+    else
+    {
+        line("%-18s%7.2f ms", "Render", r.faceLookup + r.setCharSize + r.loadChar + r.renderGlyph + r.copy);
+    }
+    line("%-18s%7.2f ms", "  face lookup", r.faceLookup);
+    line("%-18s%7.2f ms", "  FT_Set_Char_Size", r.setCharSize);
+    line("%-18s%7.2f ms", "  FT_Load_Char", r.loadChar);
+    line("%-18s%7.2f ms", "  FT_Render_Glyph", r.renderGlyph);
+    line("%-18s%7.2f ms", "  copy", r.copy);
+    line("%-18s%7.2f ms", "Signal fan-out", m_fanOutTime);
+
+    const double lineHeight = 13;
+    const double graphHeight = 50;
+    const double barWidth = 2;
+    const double width = kFrameHistorySize * barWidth;
+    const double height = lines.size() * lineHeight + graphHeight + 12;
 
-            UserData user_data;
-            user_data.cr = &cr;
-            user_data.close_current_path = [&]()
-            {
-                if (path_open)
-                {
-                    cr->close_path();
-                    cr->stroke();
-                }
-                path_open = true;
-            };
+    cr->save();
+    cr->translate(8, 8);
 
-            FT_Outline_Decompose(&outline, &funcs, (void*)&user_data);
+    cr->set_source_rgba(0, 0, 0, 0.75);
+    cr->rectangle(0, 0, width + 8, height);
+    cr->fill();
 
-            user_data.close_current_path();
-            cr->restore();
-        }
+    cr->select_font_face("monospace", Cairo::FONT_SLANT_NORMAL, Cairo::FONT_WEIGHT_NORMAL);
+    cr->set_font_size(11);
+    cr->set_source_rgb(1, 1, 1);
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        cr->move_to(4, (i + 1) * lineHeight);
+        cr->show_text(lines[i]);
     }
 
-    if (m_drawBaseline)
+    // Frame totals, scaled so two frame budgets fill the graph unless a frame took longer
+    double graphTop = lines.size() * lineHeight + 8;
+    double maxTime = 2 * kFrameBudget;
+    for (double t : m_frameTimeHistory)
     {
-        cr->save();
-
-        cr->set_source_rgb(0, 1, 1);
+        maxTime = std::max(maxTime, t);
+    }
 
-        if (m_isHorizontal)
+    double x = 4 + (kFrameHistorySize - m_frameTimeHistory.size()) * barWidth;
+    for (double t : m_frameTimeHistory)
+    {
+        double h = t / maxTime * graphHeight;
+        if (t > kFrameBudget)
         {
-            cr->arc(0, 0, 0.1, 0, 2 * M_PI);
-            cr->fill();
-
-            cr->move_to(0, 0);
-            cr->line_to(m_face->glyph->advance.x * (1.0 / 64), -m_face->glyph->advance.y * (1.0 / 64));
-            cr->stroke();
+            cr->set_source_rgb(1, 0.3, 0.3);
         }
         else
         {
-            cr->translate(-m_face->glyph->metrics.vertBearingX / 64,
-                -m_face->glyph->bitmap_top - m_face->glyph->metrics.vertBearingY / 64);
-            cr->arc(0, 0, 0.1, 0, 2 * M_PI);
-            cr->fill();
-
-            cr->move_to(0, 0);
-            cr->line_to(-m_face->glyph->advance.x * (1.0 / 64), m_face->glyph->advance.y * (1.0 / 64));
-            cr->stroke();
+            cr->set_source_rgb(0.3, 1, 0.3);
         }
-
-        cr->restore();
+        cr->rectangle(x, graphTop + graphHeight - h, barWidth, h);
+        cr->fill();
+        x += barWidth;
     }
 
-    if (pointSelected)
-    {
-        cr->save();
-        cr->translate(selX, selY);
+    double budgetY = graphTop + graphHeight - kFrameBudget / maxTime * graphHeight;
+    cr->set_source_rgba(1, 1, 1, 0.5);
+    cr->set_line_width(1);
+    cr->move_to(4, budgetY);
+    cr->line_to(4 + width, budgetY);
+    cr->stroke();
 
-        cr->set_source_rgb(0.0, 1.0, 0.0);
-        cr->move_to(0, 0);
-        cr->line_to(1, 0);
-        cr->line_to(1, 1);
-        cr->line_to(0, 1);
-        cr->close_path();
-        cr->stroke();
+    cr->restore();
+}
 
-        cr->restore();
+void FreetypeBitmapDrawer::zoomAround(double factor, double x, double y)
+{
+    double sx = x;
+    double sy = y;
 
-        if (pointSignalEmitted == false)
-        {
-            int imgX = selX - m_face->glyph->bitmap_left;
-            int imgY = selY + m_face->glyph->bitmap_top;
+    // screen space -> coord space
+    Cairo::Matrix inv = m_transformMatrix * Cairo::translation_matrix(lastWidth * 0.5, lastHeight * 0.5);
+    inv.invert();
+    inv.transform_point(x, y);
 
-            if (imgY < 0 || imgY >= bitmapHeight || imgX < 0 || imgX >= bitmapWidth)
-            {
-                m_signals.pixel_selected.emit(0, 0);
-            }
-            else
-            {
-                uint32_t red   = 0;
-                uint32_t green = 0;
-                uint32_t blue  = 0;
-                uint32_t alpha = 255;
+    m_transformMatrix.scale(factor, factor);
 
-                switch (bitmap.pixel_mode)
-                {
-                case FT_PIXEL_MODE_LCD:
-                {
-                    red   = (bitmap.buffer + imgY * bitmap.pitch)[3*imgX+0];
-                    green = (bitmap.buffer + imgY * bitmap.pitch)[3*imgX+1];
-                    blue  = (bitmap.buffer + imgY * bitmap.pitch)[3*imgX+2];
-                    break;
-                }
-                case FT_PIXEL_MODE_LCD_V:
-                {
-                    red   = (bitmap.buffer + (3*imgY+0) * bitmap.pitch)[imgX];
-                    green = (bitmap.buffer + (3*imgY+1) * bitmap.pitch)[imgX];
-                    blue  = (bitmap.buffer + (3*imgY+2) * bitmap.pitch)[imgX];
-                    break;
-                }
-                case FT_PIXEL_MODE_GRAY:
-                {
-                    red = green = blue = (bitmap.buffer + (imgY) * bitmap.pitch)[imgX];
-                    break;
-                }
-                case FT_PIXEL_MODE_MONO:
-                {
+    // coord space -> new screen space
+    (m_transformMatrix * Cairo::translation_matrix(lastWidth * 0.5, lastHeight * 0.5)).transform_point(x, y);
 
-                    uint32_t byte = (bitmap.buffer + imgY * bitmap.pitch)[imgX/8];
-                    byte &= (((uint32_t)1) << (7-(imgX%8)));
-                    if (byte)
-                    {
-                        red = green = blue = 255;
-                    }
-                    else
-                    {
-                        red = green = blue = 0;
-                    }
-                    break;
-                }
-                case FT_PIXEL_MODE_BGRA:
-                {
-                    red   = (bitmap.buffer + imgY * bitmap.pitch)[4*imgX+2];
-                    green = (bitmap.buffer + imgY * bitmap.pitch)[4*imgX+1];
-                    blue  = (bitmap.buffer + imgY * bitmap.pitch)[4*imgX+0];
-                    alpha = (bitmap.buffer + imgY * bitmap.pitch)[4*imgX+3];
-                    break;
-                }
-                }
+    // offset extra translation caused by the zoom
+    m_transformMatrix = m_transformMatrix * Cairo::translation_matrix(sx - x, sy - y);
+}
 
-                m_signals.pixel_selected.emit(1, (red << 24) | (green << 16) | (blue << 8) | alpha);
-            }
+void FreetypeBitmapDrawer::scheduleViewUpdate()
+{
+    if (m_viewTickId) return;
 
-            pointSignalEmitted = true;
-        }
+    m_lastTickTime = 0;
+    m_viewTickId = add_tick_callback([this](const Glib::RefPtr<Gdk::FrameClock> &clock) -> bool
+    {
+        return updateView(clock->get_frame_time());
+    });
+}
+
+bool FreetypeBitmapDrawer::updateView(gint64 frameTime)
+{
+    double dt = m_lastTickTime ? (frameTime - m_lastTickTime) * 1e-6 : 1.0 / 60;
+    m_lastTickTime = frameTime;
+
+    // Panned by whole pixels only, the rest stays pending. Tiles bake in the
+    // fractional part of the translation, changing it repaints all of them.
+    double panX = std::round(m_pendingPanX);
+    double panY = std::round(m_pendingPanY);
+    m_transformMatrix = m_transformMatrix * Cairo::translation_matrix(panX, panY);
+    m_pendingPanX -= panX;
+    m_pendingPanY -= panY;
+
+    double step = m_pendingZoom * (1 - std::exp(-dt / kZoomSmoothing));
+    if (std::abs(m_pendingZoom - step) < 1e-3)
+    {
+        step = m_pendingZoom;
+    }
+    m_pendingZoom -= step;
+    if (step != 0)
+    {
+        zoomAround(std::exp(step), m_zoomAnchorX, m_zoomAnchorY);
     }
 
-    return true;
+    queue_draw();
+
+    if (m_pendingZoom != 0) return true;
+
+    m_viewTickId = 0;
+    return false;
 }
 
 
@@ -428,9 +463,8 @@ Gtk::Widget& makeBoldLabel(const std::string &text)
 }
 
 
-FreetypeBitmapDrawer::FreetypeBitmapDrawer(FT_Face &face, Signals &signals)
-    : m_face(face)
-    , m_signals(signals)
+FreetypeBitmapDrawer::FreetypeBitmapDrawer(Signals &signals)
+    : m_signals(signals)
 {
     set_size_request(700, 700);
     set_hexpand(true);
@@ -439,7 +473,8 @@ FreetypeBitmapDrawer::FreetypeBitmapDrawer(FT_Face &face, Signals &signals)
     add_events(Gdk::EventMask::BUTTON_PRESS_MASK
              | Gdk::EventMask::BUTTON_RELEASE_MASK
              | Gdk::EventMask::BUTTON1_MOTION_MASK
-             | Gdk::EventMask::SCROLL_MASK);
+             | Gdk::EventMask::SCROLL_MASK
+             | Gdk::EventMask::SMOOTH_SCROLL_MASK);
 
     signal_button_press_event().connect([this](GdkEventButton *ev) -> bool
     {
@@ -473,44 +508,52 @@ FreetypeBitmapDrawer::FreetypeBitmapDrawer(FT_Face &face, Signals &signals)
     {
         hadMotion = true;
 
-        double dx = ev->x - lastX;
-        double dy = ev->y - lastY;
+        m_pendingPanX += ev->x - lastX;
+        m_pendingPanY += ev->y - lastY;
         lastX = ev->x;
         lastY = ev->y;
 
-        m_transformMatrix = m_transformMatrix * Cairo::translation_matrix(dx, dy);
-
-        queue_draw();
+        scheduleViewUpdate();
         return true;
     });
 
     signal_scroll_event().connect([this](GdkEventScroll *ev) -> bool
     {
-        double factor;
         switch (ev->direction)
         {
-        case GDK_SCROLL_UP:   factor = 1.1; break;
-        case GDK_SCROLL_DOWN: factor = (1.0 / 1.1); break;
+        case GDK_SCROLL_UP:   m_pendingZoom += kZoomStep; break;
+        case GDK_SCROLL_DOWN: m_pendingZoom -= kZoomStep; break;
+        case GDK_SCROLL_SMOOTH:
+        {
+            if (gdk_event_is_scroll_stop_event(reinterpret_cast<GdkEvent*>(ev)))
+            {
+                // Fingers lifted, keep zooming for a moment at the last speed
+                m_pendingZoom += m_zoomVelocity * kZoomKineticTime;
+                m_zoomVelocity = 0;
+                m_lastSmoothScrollTime = 0;
+                break;
+            }
+
+            double delta = -ev->delta_y * kZoomStep;
+            double dt = (ev->time - m_lastSmoothScrollTime) * 1e-3;
+            if (m_lastSmoothScrollTime != 0 && dt > 0 && dt < 0.1)
+            {
+                m_zoomVelocity = 0.5 * m_zoomVelocity + 0.5 * delta / dt;
+            }
+            else
+            {
+                m_zoomVelocity = 0;
+            }
+            m_lastSmoothScrollTime = ev->time;
+            m_pendingZoom += delta;
+            break;
+        }
         default: return true;
         };
 
-        double x = ev->x;
-        double y = ev->y;
-
-        // screen space -> coord space
-        Cairo::Matrix inv = m_transformMatrix * Cairo::translation_matrix(lastWidth * 0.5, lastHeight * 0.5);
-        inv.invert();
-        inv.transform_point(x, y);
-
-        m_transformMatrix.scale(factor, factor);
-
-        // coord space -> new screen space
-        (m_transformMatrix * Cairo::translation_matrix(lastWidth * 0.5, lastHeight * 0.5)).transform_point(x, y);
-
-        // offset extra translation caused by the zoom
-        m_transformMatrix = m_transformMatrix * Cairo::translation_matrix(ev->x - x, ev->y - y);
-
-        queue_draw();
+        m_zoomAnchorX = ev->x;
+        m_zoomAnchorY = ev->y;
+        scheduleViewUpdate();
         return true;
     });
 
@@ -18,19 +18,94 @@
 #pragma once
 
 #include "common.hpp"
+#include "glyph_painter.hpp"
 
+#include <cairomm/surface.h>
 #include <gtkmm/drawingarea.h>
 #include <gtkmm/grid.h>
 
+#include <deque>
+#include <map>
+#include <utility>
+
 struct FreetypeBitmapDrawer : public Gtk::DrawingArea
 {
-    FreetypeBitmapDrawer(FT_Face &face, Signals &signals);
+    FreetypeBitmapDrawer(Signals &signals);
+
+    void setGlyph(RenderedGlyphPtr glyph);
+
+    // Shows frame and render stage timings over the view. Nothing is timed
+    // while it is off.
+    void setTimingOverlay(bool enabled);
+    bool timingOverlay() const { return m_timingOverlay; }
+    // Stages behind the shown glyph, `fanOutTime` is what delivering it to
+    // the UI took, in milliseconds
+    void setRenderTimings(const RenderTimings &timings, double fanOutTime);
 
 protected:
     bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
 
+private:
+    // Composites the scene from cached tiles, rendering the missing ones
+    void drawTiles(const Cairo::RefPtr<Cairo::Context>& cr, const Cairo::Matrix &viewMatrix);
+
+    void drawTimingOverlay(const Cairo::RefPtr<Cairo::Context>& cr);
+
+    // Scales the view by `factor`, keeping screen point (x, y) in place
+    void zoomAround(double factor, double x, double y);
+    // Pan and zoom input is collected and applied once per frame clock tick
+    void scheduleViewUpdate();
+    bool updateView(gint64 frameTime);
+
+    // Drag distance not applied yet, at most half a pixel once a tick has run
+    double m_pendingPanX = 0;
+    double m_pendingPanY = 0;
+    // Log of the zoom factor still to be applied, eased in over a few frames
+    double m_pendingZoom = 0;
+    double m_zoomAnchorX = 0;
+    double m_zoomAnchorY = 0;
+    // Smooth scroll speed in log zoom per second, for coasting after a touchpad zoom
+    double m_zoomVelocity = 0;
+    guint32 m_lastSmoothScrollTime = 0;
+    gint64 m_lastTickTime = 0;
+    guint m_viewTickId = 0;
+
+    GlyphPainter m_painter;
+
+    // Everything a tile's contents depend on, the translation only by its fractional part
+    struct TileKey
+    {
+        const RenderedGlyph *glyph = nullptr;
+        double xx = 0, yx = 0, xy = 0, yy = 0, x0 = 0, y0 = 0;
+        bool grayscaleLCD = false, baseline = false, grid = false, outline = false, perPixel = false, horizontal = false;
+
+        bool operator==(const TileKey &o) const;
+    };
+
+    // Rendered tiles by tile coordinates, all drawn for m_tileKey
+    std::map<std::pair<int, int>, Cairo::RefPtr<Cairo::Surface>> m_tiles;
+    TileKey m_tileKey;
+
+    // Timing overlay state, in milliseconds
+    struct FrameTimings
+    {
+        // Layers of the tiles rendered this frame
+        PaintTimings paint;
+        int tilesRendered = 0;
+        // drawTiles() as a whole, painting included
+        double tiles = 0;
+        double overlays = 0;
+        double total = 0;
+    };
+    bool m_timingOverlay = false;
+    RenderTimings m_renderTimings;
+    double m_fanOutTime = 0;
+    FrameTimings m_frameTimings;
+    // Totals of the latest frames, oldest first
+    std::deque<double> m_frameTimeHistory;
+
 public: // TODO
-    FT_Face &m_face;
+    RenderedGlyphPtr m_glyph;
     Signals &m_signals;
 
     bool m_drawGrayscaleLCD = false;
@@ -38,6 +113,10 @@ public: // TODO
     bool m_drawGrid = false;
     bool m_drawOutline = false;
 
+    // Debug options, for comparing against the old per-pixel fill path
+    bool m_drawPerPixel = false;
+    bool m_logFrameTimes = false;
+
     bool m_isHorizontal = true;
 
     double lastX, lastY;
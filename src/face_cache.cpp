@@ -0,0 +1,109 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "face_cache.hpp"
+#include "font_file.hpp"
+#include "trace.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+
+size_t defaultFaceCacheBudget()
+{
+    size_t megabytes = 256;
+    if (const char *env = getenv("FONTDEBUG_FACE_CACHE_MB"))
+    {
+        megabytes = strtoull(env, nullptr, 10);
+    }
+    return megabytes << 20;
+}
+
+FaceCache::FaceCache(FT_Library ft, size_t budget)
+    : m_ft(ft)
+{
+    m_stats.budget = budget;
+}
+
+FaceCache::~FaceCache()
+{
+    for (const Entry &entry : m_entries)
+    {
+        FT_Done_Face(entry.face.face);
+    }
+}
+
+FaceCache::Face FaceCache::acquire(const std::string &path, FT_Long faceIndex)
+{
+    TRACE_SCOPE("render", "FaceCache::acquire");
+
+    // Errors are left to mapFontFile, which reports them better
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    int64_t mtimeKey = ec ? 0 : (int64_t)mtime.time_since_epoch().count();
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        if (it->path == path && it->faceIndex == faceIndex && it->mtime == mtimeKey)
+        {
+            m_entries.splice(m_entries.begin(), m_entries, it);
+            ++m_stats.hits;
+            return it->face;
+        }
+    }
+
+    ++m_stats.misses;
+
+    Entry entry;
+    entry.path = path;
+    entry.faceIndex = faceIndex;
+    entry.mtime = mtimeKey;
+
+    // Faces on the same file share one mapping, and FreeType reads the
+    // tables from it in place
+    entry.file = mapFontFile(path);
+
+    // Parsed tables are not measurable, the file size is a stable stand-in
+    entry.bytes = entry.file->size();
+
+    FT_Error errorCode = openMappedFace(m_ft, *entry.file, faceIndex, &entry.face.face);
+    if (errorCode) throw FreetypeError(errorCode, "FT_Open_Face");
+    entry.face.info = makeFaceInfo(entry.face.face, path, faceIndex);
+
+    m_entries.push_front(std::move(entry));
+    m_stats.bytes += m_entries.front().bytes;
+    ++m_stats.faces;
+    evict();
+
+    return m_entries.front().face;
+}
+
+void FaceCache::evict()
+{
+    // The front entry is in use by the caller
+    while (m_stats.bytes > m_stats.budget && m_entries.size() > 1)
+    {
+        const Entry &victim = m_entries.back();
+        {
+            TRACE_SCOPE("freetype", "FT_Done_Face");
+            FT_Done_Face(victim.face.face);
+        }
+        m_stats.bytes -= victim.bytes;
+        --m_stats.faces;
+        ++m_stats.evictions;
+        m_entries.pop_back();
+    }
+}
@@ -0,0 +1,90 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "render.hpp"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+
+#include <freetype/freetype.h>
+
+class MappedFontFile;
+
+struct FaceCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t faces = 0;
+    // Sum of the file sizes of the open faces, charged against `budget`
+    size_t bytes = 0;
+    size_t budget = 0;
+};
+
+// Memory budget from FONTDEBUG_FACE_CACHE_MB, 256 MiB by default
+size_t defaultFaceCacheBudget();
+
+// Open faces keyed by (path, face index, file mtime), so going back to a
+// font skips parsing its tables again. A file changed on disk gets a new key
+// and its old face ages out.
+//
+// Each face is charged its file size, and the least recently used faces are
+// closed once the total exceeds the budget. The face returned by the latest
+// acquire() is never closed by the cache. Not thread safe.
+class FaceCache
+{
+public:
+    struct Face
+    {
+        FT_Face face = nullptr;
+        std::shared_ptr<const FaceInfo> info;
+    };
+
+    FaceCache(FT_Library ft, size_t budget);
+    ~FaceCache();
+
+    FaceCache(const FaceCache&) = delete;
+    FaceCache& operator=(const FaceCache&) = delete;
+
+    // Returns the cached face or opens it, throws FreetypeError on failure
+    Face acquire(const std::string &path, FT_Long faceIndex);
+
+    const FaceCacheStats& stats() const { return m_stats; }
+
+private:
+    struct Entry
+    {
+        std::string path;
+        FT_Long faceIndex;
+        int64_t mtime;
+        size_t bytes;
+        Face face;
+        // Backs the face, released after it
+        std::shared_ptr<const MappedFontFile> file;
+    };
+
+    void evict();
+
+    FT_Library m_ft;
+    // Most recently used first
+    std::list<Entry> m_entries;
+    FaceCacheStats m_stats;
+};
@@ -0,0 +1,111 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "font_file.hpp"
+#include "trace.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Mappings by path, entries expire with the last face using them
+std::mutex g_mappingsMutex;
+std::unordered_map<std::string, std::weak_ptr<const MappedFontFile>> g_mappings;
+
+std::runtime_error fileError(const std::string &path, const char *method)
+{
+    return std::runtime_error(path + ": " + method + ": " + strerror(errno));
+}
+
+}
+
+MappedFontFile::~MappedFontFile()
+{
+    if (m_data) munmap(const_cast<FT_Byte*>(m_data), m_size);
+}
+
+std::shared_ptr<const MappedFontFile> mapFontFile(const std::string &path)
+{
+    TRACE_SCOPE("render", "mapFontFile");
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw fileError(path, "open");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        std::runtime_error error = fileError(path, "fstat");
+        close(fd);
+        throw error;
+    }
+    int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+    std::lock_guard<std::mutex> lock(g_mappingsMutex);
+
+    // Files replaced on disk get a new mapping, faces of the old one keep theirs
+    std::weak_ptr<const MappedFontFile> &slot = g_mappings[path];
+    if (auto existing = slot.lock())
+    {
+        if (existing->m_mtime == mtime && existing->m_inode == (uint64_t)st.st_ino && existing->m_size == (size_t)st.st_size)
+        {
+            close(fd);
+            return existing;
+        }
+    }
+
+    std::shared_ptr<MappedFontFile> file(new MappedFontFile());
+    file->m_path = path;
+    file->m_size = st.st_size;
+    file->m_mtime = mtime;
+    file->m_inode = st.st_ino;
+
+    // mmap rejects empty files, FreeType reports those as an unknown format
+    if (file->m_size > 0)
+    {
+        void *data = mmap(nullptr, file->m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            std::runtime_error error = fileError(path, "mmap");
+            close(fd);
+            throw error;
+        }
+        file->m_data = static_cast<const FT_Byte*>(data);
+    }
+    close(fd);
+
+    slot = file;
+    return file;
+}
+
+FT_Error openMappedFace(FT_Library ft, const MappedFontFile &file, FT_Long faceIndex, FT_Face *face)
+{
+    FT_Open_Args args = {};
+    args.flags = FT_OPEN_MEMORY;
+    args.memory_base = file.data();
+    args.memory_size = (FT_Long)file.size();
+
+    TRACE_SCOPE("freetype", "FT_Open_Face");
+    return FT_Open_Face(ft, &args, faceIndex, face);
+}
@@ -0,0 +1,59 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <freetype/freetype.h>
+
+// Read-only memory mapping of a font file. Faces opened from it read their
+// tables straight from the page cache instead of copying them through
+// FreeType's stdio stream.
+class MappedFontFile
+{
+public:
+    ~MappedFontFile();
+
+    MappedFontFile(const MappedFontFile&) = delete;
+    MappedFontFile& operator=(const MappedFontFile&) = delete;
+
+    const std::string& path() const { return m_path; }
+    const FT_Byte* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    friend std::shared_ptr<const MappedFontFile> mapFontFile(const std::string &path);
+    MappedFontFile() = default;
+
+    std::string m_path;
+    const FT_Byte *m_data = nullptr;
+    size_t m_size = 0;
+    // Identifies the file contents the mapping was made from
+    int64_t m_mtime = 0;
+    uint64_t m_inode = 0;
+};
+
+// Maps `path`, or returns the existing mapping when a face anywhere in the
+// process still uses one of the same unmodified file. Throws
+// std::runtime_error when the file can't be read.
+std::shared_ptr<const MappedFontFile> mapFontFile(const std::string &path);
+
+// FT_Open_Face over the mapping, which must outlive the returned face
+FT_Error openMappedFace(FT_Library ft, const MappedFontFile &file, FT_Long faceIndex, FT_Face *face);
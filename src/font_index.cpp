@@ -0,0 +1,497 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "font_index.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char *kIndexHeader = "FontDebug font index 2";
+
+// What the index remembers of one scanned directory
+struct IndexedDir
+{
+    int64_t mtime = 0;
+    std::vector<std::string> subdirs;
+    std::vector<FontIndexEntry> fonts;
+};
+
+using DirIndex = std::unordered_map<std::string, IndexedDir>;
+
+int64_t mtimeOf(const fs::path &path, std::error_code &ec)
+{
+    return fs::last_write_time(path, ec).time_since_epoch().count();
+}
+
+bool isFontFile(const std::string &name)
+{
+    return *fontFormatName(name) != '\0';
+}
+
+// Appends one entry per face of `file` to `fonts`, or `file` with a zero
+// faceCount if FreeType can not open it
+void describeFont(FT_Library ft, const FontIndexEntry &file, std::vector<FontIndexEntry> &fonts)
+{
+    TRACE_SCOPE("freetype", "describeFont");
+
+    FontIndexEntry entry = file;
+    entry.faceCount = 0;
+    for (FT_Long faceIndex = 0; faceIndex == 0 || faceIndex < entry.faceCount; ++faceIndex)
+    {
+        FT_Face face;
+        if (FT_New_Face(ft, file.path.c_str(), faceIndex, &face))
+        {
+            // Faces after the first are skipped, the file stays listed
+            if (faceIndex == 0) fonts.push_back(entry);
+            continue;
+        }
+
+        entry.faceIndex = faceIndex;
+        entry.faceCount = face->num_faces;
+        entry.family = face->family_name ? face->family_name : "";
+        entry.style = face->style_name ? face->style_name : "";
+        FT_Done_Face(face);
+        fonts.push_back(entry);
+    }
+}
+
+// Index file format, one record per line with tab separated fields:
+//   D <mtime> <path>                                          a scanned directory
+//   S <path>                                                  subdirectory of the last D
+//   F <mtime> <size> <faces> <face> <family> <style> <path>   face of a font file in the last D
+DirIndex readIndex(const std::string &cachePath)
+{
+    DirIndex index;
+    std::ifstream in(cachePath);
+
+    std::string line;
+    if (!std::getline(in, line) || line != kIndexHeader) return index;
+
+    IndexedDir *dir = nullptr;
+    while (std::getline(in, line))
+    {
+        std::vector<std::string> fields;
+        std::istringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, '\t'))
+        {
+            fields.push_back(field);
+        }
+
+        try
+        {
+            if (fields.size() == 3 && fields[0] == "D")
+            {
+                dir = &index[fields[2]];
+                dir->mtime = std::stoll(fields[1]);
+            }
+            else if (dir && fields.size() == 2 && fields[0] == "S")
+            {
+                dir->subdirs.push_back(fields[1]);
+            }
+            else if (dir && fields.size() == 8 && fields[0] == "F")
+            {
+                FontIndexEntry font;
+                font.mtime = std::stoll(fields[1]);
+                font.size = std::stoull(fields[2]);
+                font.faceCount = std::stol(fields[3]);
+                font.faceIndex = std::stol(fields[4]);
+                font.family = fields[5];
+                font.style = fields[6];
+                font.path = fields[7];
+                dir->fonts.push_back(std::move(font));
+            }
+        }
+        catch (const std::exception&)
+        {
+            // Damaged line, the next scan rewrites the file anyway
+        }
+    }
+
+    return index;
+}
+
+void writeIndex(const std::string &cachePath, const DirIndex &index)
+{
+    auto clean = [](const std::string &s)
+    {
+        return s.find_first_of("\t\n") == std::string::npos;
+    };
+
+    std::error_code ec;
+    fs::create_directories(fs::path(cachePath).parent_path(), ec);
+
+    // Written aside and renamed over, so a reader never sees half a file
+    std::string tmpPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tmpPath);
+        out << kIndexHeader << "\n";
+        for (const auto &[path, dir] : index)
+        {
+            if (!clean(path)) continue;
+            out << "D\t" << dir.mtime << "\t" << path << "\n";
+            for (const std::string &subdir : dir.subdirs)
+            {
+                if (clean(subdir)) out << "S\t" << subdir << "\n";
+            }
+            for (const FontIndexEntry &font : dir.fonts)
+            {
+                if (!clean(font.path) || !clean(font.family) || !clean(font.style)) continue;
+                out << "F\t" << font.mtime << "\t" << font.size << "\t" << font.faceCount << "\t" << font.faceIndex << "\t"
+                    << font.family << "\t" << font.style << "\t" << font.path << "\n";
+            }
+        }
+        if (!out) return;
+    }
+    fs::rename(tmpPath, cachePath, ec);
+}
+
+FontIndex usableFonts(const DirIndex &index)
+{
+    FontIndex fonts;
+    for (const auto &[path, dir] : index)
+    {
+        for (const FontIndexEntry &font : dir.fonts)
+        {
+            if (font.faceCount > 0) fonts.push_back(font);
+        }
+    }
+    std::sort(fonts.begin(), fonts.end(), [](const FontIndexEntry &a, const FontIndexEntry &b)
+    {
+        return a.path != b.path ? a.path < b.path : a.faceIndex < b.faceIndex;
+    });
+    return fonts;
+}
+
+// Directory walk shared by the scanning threads. Each thread takes a
+// directory from the queue, lists it and queues its subdirectories.
+class Scan
+{
+public:
+    Scan(const DirIndex &previous, const std::atomic<bool> &cancel)
+        : m_previous(previous)
+        , m_cancel(cancel)
+    {
+    }
+
+    DirIndex run(const std::vector<std::string> &dirs)
+    {
+        for (const std::string &dir : dirs)
+        {
+            enqueue(dir);
+        }
+
+        unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<FT_Library> libraries(threadCount);
+        for (FT_Library &ft : libraries)
+        {
+            if (FT_Init_FreeType(&ft)) throw std::runtime_error("FT_Init_FreeType");
+        }
+
+        std::vector<std::thread> threads;
+        for (FT_Library ft : libraries)
+        {
+            threads.emplace_back([this, ft]()
+            {
+                setTraceThreadName("font scan");
+                work(ft);
+            });
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+
+        for (FT_Library ft : libraries)
+        {
+            FT_Done_FreeType(ft);
+        }
+        return std::move(m_result);
+    }
+
+private:
+    // Caller holds m_mutex or no thread is running yet
+    void enqueue(const std::string &dir)
+    {
+        if (m_seen.insert(dir).second)
+        {
+            m_queue.push_back(dir);
+        }
+    }
+
+    void work(FT_Library ft)
+    {
+        while (true)
+        {
+            std::string dir;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this]() { return m_cancel || !m_queue.empty() || m_busy == 0; });
+                if (m_cancel || m_queue.empty()) return;
+
+                dir = std::move(m_queue.front());
+                m_queue.pop_front();
+                ++m_busy;
+            }
+
+            IndexedDir scanned;
+            bool ok = scanDir(ft, dir, scanned);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (ok)
+                {
+                    for (const std::string &subdir : scanned.subdirs)
+                    {
+                        enqueue(subdir);
+                    }
+                    m_result[dir] = std::move(scanned);
+                }
+                --m_busy;
+            }
+            m_cond.notify_all();
+        }
+    }
+
+    bool scanDir(FT_Library ft, const std::string &path, IndexedDir &dir)
+    {
+        std::error_code ec;
+        dir.mtime = mtimeOf(path, ec);
+        if (ec) return false;
+
+        // Adding or removing entries changes the directory mtime, an unchanged
+        // directory has the same fonts and subdirectories as last time
+        auto prev = m_previous.find(path);
+        if (prev != m_previous.end() && prev->second.mtime == dir.mtime)
+        {
+            dir.subdirs = prev->second.subdirs;
+            dir.fonts = prev->second.fonts;
+            return true;
+        }
+
+        // Faces of each file, in index order
+        std::unordered_map<std::string, std::vector<const FontIndexEntry*>> prevFonts;
+        if (prev != m_previous.end())
+        {
+            for (const FontIndexEntry &font : prev->second.fonts)
+            {
+                prevFonts[font.path].push_back(&font);
+            }
+        }
+
+        for (const fs::directory_entry &entry : fs::directory_iterator(path, fs::directory_options::skip_permission_denied, ec))
+        {
+            if (m_cancel) return false;
+
+            std::error_code entryEc;
+            // Symlinked directories are skipped, they tend to point back into the tree
+            if (entry.is_directory(entryEc) && !entry.is_symlink(entryEc))
+            {
+                dir.subdirs.push_back(entry.path());
+                continue;
+            }
+            if (!entry.is_regular_file(entryEc) || !isFontFile(entry.path().filename())) continue;
+
+            FontIndexEntry font;
+            font.path = entry.path();
+            font.mtime = mtimeOf(entry.path(), entryEc);
+            font.size = entry.file_size(entryEc);
+            if (entryEc) continue;
+
+            auto it = prevFonts.find(font.path);
+            if (it != prevFonts.end() && it->second.front()->mtime == font.mtime && it->second.front()->size == font.size)
+            {
+                for (const FontIndexEntry *face : it->second)
+                {
+                    dir.fonts.push_back(*face);
+                }
+            }
+            else
+            {
+                describeFont(ft, font, dir.fonts);
+            }
+        }
+        return !ec;
+    }
+
+    const DirIndex &m_previous;
+    const std::atomic<bool> &m_cancel;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::string> m_queue;
+    std::unordered_set<std::string> m_seen;
+    size_t m_busy = 0;
+    DirIndex m_result;
+};
+
+} // namespace
+
+const char* fontFormatName(const std::string &path)
+{
+    static const std::pair<const char*, const char*> formats[] = {
+        { ".ttf",    "TrueType" },
+        { ".otf",    "OpenType" },
+        { ".ttc",    "Collection" },
+        { ".otc",    "Collection" },
+        { ".woff",   "WOFF" },
+        { ".woff2",  "WOFF2" },
+        { ".pcf",    "PCF" },
+        { ".pcf.gz", "PCF" },
+    };
+
+    std::string name = path.substr(path.rfind('/') + 1);
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return tolower(c); });
+
+    for (const auto &[ext, format] : formats)
+    {
+        size_t len = strlen(ext);
+        if (name.size() > len && name.compare(name.size() - len, len, ext) == 0) return format;
+    }
+    return "";
+}
+
+std::vector<std::string> fontDirs()
+{
+    std::vector<std::string> dirs;
+    auto split = [&](const std::string &list, const std::string &suffix)
+    {
+        std::istringstream ss(list);
+        std::string dir;
+        while (std::getline(ss, dir, ':'))
+        {
+            if (!dir.empty() && std::find(dirs.begin(), dirs.end(), dir + suffix) == dirs.end())
+            {
+                dirs.push_back(dir + suffix);
+            }
+        }
+    };
+
+    if (const char *env = getenv("FONTDEBUG_FONT_DIRS"))
+    {
+        split(env, "");
+        return dirs;
+    }
+
+    const char *home = getenv("HOME");
+    if (const char *dataHome = getenv("XDG_DATA_HOME"))
+    {
+        split(dataHome, "/fonts");
+    }
+    else if (home)
+    {
+        split(std::string(home) + "/.local/share", "/fonts");
+    }
+    if (home)
+    {
+        split(home, "/.fonts");
+    }
+
+    const char *dataDirs = getenv("XDG_DATA_DIRS");
+    split(dataDirs && *dataDirs ? dataDirs : "/usr/local/share:/usr/share", "/fonts");
+
+    // Some sessions (Flatpak, Nix) leave /usr/share out of XDG_DATA_DIRS,
+    // the system fonts are scanned regardless
+    split("/usr/share", "/fonts");
+
+    return dirs;
+}
+
+std::string fontIndexCachePath()
+{
+    if (const char *cacheHome = getenv("XDG_CACHE_HOME"))
+    {
+        if (*cacheHome) return std::string(cacheHome) + "/fontdebug/font-index";
+    }
+    if (const char *home = getenv("HOME"))
+    {
+        return std::string(home) + "/.cache/fontdebug/font-index";
+    }
+    return "";
+}
+
+FontIndex loadFontIndex(const std::string &cachePath)
+{
+    if (cachePath.empty()) return {};
+    return usableFonts(readIndex(cachePath));
+}
+
+FontIndex scanFonts(const std::vector<std::string> &dirs, const std::string &cachePath, const std::atomic<bool> &cancel)
+{
+    DirIndex previous;
+    if (!cachePath.empty())
+    {
+        previous = readIndex(cachePath);
+    }
+
+    DirIndex scanned = Scan(previous, cancel).run(dirs);
+    if (cancel) return {};
+
+    if (!cachePath.empty())
+    {
+        writeIndex(cachePath, scanned);
+    }
+    return usableFonts(scanned);
+}
+
+FontScanner::FontScanner(std::function<void()> notify)
+    : m_notify(std::move(notify))
+{
+    m_thread = std::thread([this]()
+    {
+        setTraceThreadName("font index");
+        std::shared_ptr<const FontIndex> index;
+        {
+            TRACE_SCOPE("scan", "scanFonts");
+            index = std::make_shared<const FontIndex>(scanFonts(fontDirs(), fontIndexCachePath(), m_cancel));
+        }
+        if (m_cancel) return;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_result = std::move(index);
+        }
+        m_notify();
+    });
+}
+
+FontScanner::~FontScanner()
+{
+    m_cancel = true;
+    m_thread.join();
+}
+
+std::shared_ptr<const FontIndex> FontScanner::takeResult()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::move(m_result);
+}
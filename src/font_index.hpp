@@ -0,0 +1,95 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <freetype/freetype.h>
+
+struct FontIndexEntry
+{
+    std::string path;
+    // Filesystem clock ticks, only meaningful for comparing with another scan
+    int64_t mtime = 0;
+    uint64_t size = 0;
+
+    // Face of the file this entry describes, collections have one entry
+    // per face
+    FT_Long faceIndex = 0;
+    // Of that face, as FreeType reports them
+    std::string family;
+    std::string style;
+    // Number of faces in the file, 0 if FreeType can not open it
+    FT_Long faceCount = 0;
+};
+
+// One entry per face
+using FontIndex = std::vector<FontIndexEntry>;
+
+// File format from the extension: "TrueType", "OpenType", "Collection",
+// "WOFF", "WOFF2", "PCF" or "" for anything else
+const char* fontFormatName(const std::string &path);
+
+// $FONTDEBUG_FONT_DIRS if set (colon separated), otherwise the XDG font
+// directories: $XDG_DATA_HOME/fonts, ~/.fonts and $XDG_DATA_DIRS/*/fonts,
+// plus /usr/share/fonts when $XDG_DATA_DIRS lacks it
+std::vector<std::string> fontDirs();
+
+// Index file under $XDG_CACHE_HOME (~/.cache), empty if there is no home
+std::string fontIndexCachePath();
+
+// Faces FreeType could open as of the last scan, sorted by path and face
+// index. Empty if there is no index yet.
+FontIndex loadFontIndex(const std::string &cachePath);
+
+// Scans `dirs` recursively on one thread per core and rewrites the index.
+// Directories whose mtime matches the index are not read again, and files
+// whose mtime and size match are not opened again. Returns an empty index
+// if `cancel` is set before it is done.
+FontIndex scanFonts(const std::vector<std::string> &dirs, const std::string &cachePath, const std::atomic<bool> &cancel);
+
+// Runs scanFonts() over fontDirs() on a background thread
+class FontScanner
+{
+public:
+    // `notify` is called on the scanner thread once the scan is done
+    explicit FontScanner(std::function<void()> notify);
+    ~FontScanner();
+
+    FontScanner(const FontScanner&) = delete;
+    FontScanner& operator=(const FontScanner&) = delete;
+
+    // The scan result, nullptr until it is done
+    std::shared_ptr<const FontIndex> takeResult();
+
+private:
+    std::function<void()> m_notify;
+    std::atomic<bool> m_cancel{ false };
+
+    std::mutex m_mutex;
+    std::shared_ptr<const FontIndex> m_result;
+
+    std::thread m_thread;
+};
@@ -15,10 +15,13 @@
 // You should have received a copy of the GNU General Public License
 // along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <ctime>
 #include <cmath>
-#include <filesystem>
 #include <iostream>
+#include <set>
 #include <sstream>
 
 #include <unicode/utypes.h>
@@ -27,6 +30,7 @@
 #include <cinttypes>
 
 #include <cairomm/context.h>
+#include <glibmm/dispatcher.h>
 #include <glibmm/main.h>
 
 #include <gtkmm/adjustment.h>
@@ -48,20 +52,29 @@
 #include <gtkmm/separator.h>
 #include <gtkmm/scale.h>
 #include <gtkmm/scrolledwindow.h>
-#include <gtkmm/treestore.h>
+#include <gtkmm/searchentry.h>
+#include <gtkmm/treemodelfilter.h>
+#include <gtkmm/treeview.h>
 #include <gtkmm/label.h>
+#include <gtkmm/liststore.h>
 #include <gtkmm/spinbutton.h>
 #include <gtkmm/window.h>
 #include <gtkmm/paned.h>
+#include <gtkmm/progressbar.h>
 #include <gtkmm/textview.h>
 #include <gtkmm/toolbar.h>
 #include <gtkmm/toolitem.h>
 #include <gtkmm/stock.h>
+#include <gdkmm/frameclock.h>
 #include <gdkmm/pixbufloader.h>
 
 #include "common.hpp"
 
 #include "drawer.hpp"
+#include "font_index.hpp"
+#include "glyph_list_model.hpp"
+#include "glyph_search.hpp"
+#include "render_worker.hpp"
 
 
 #if (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
@@ -86,346 +99,26 @@ along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.)";
 extern unsigned char resources_app_icon_png[];
 extern unsigned int resources_app_icon_png_len;
 
-std::runtime_error FreetypeError(FT_Error errorCode, const char *method)
+struct FontListColumns : public Gtk::TreeModel::ColumnRecord
 {
-    char buf[1000];
-    sprintf(buf, "FreeType error: %s: (%d) %s", method, errorCode, FT_Error_String(errorCode));
-    return std::runtime_error(buf);
-}
-
-struct FontGlyphSelectorColumns : public Gtk::TreeModel::ColumnRecord
-{
-    FontGlyphSelectorColumns()
+    FontListColumns()
     {
-        add(colCode);
-        add(colName);
-        add(colCharCodeInt);
+        add(colFamily);
+        add(colStyle);
+        add(colFormat);
+        add(colPath);
+        add(colFaceIndex);
     }
 
-    Gtk::TreeModelColumn<Glib::ustring> colCode;
-    Gtk::TreeModelColumn<Glib::ustring> colName;
-    Gtk::TreeModelColumn<int> colCharCodeInt;
+    Gtk::TreeModelColumn<Glib::ustring> colFamily;
+    Gtk::TreeModelColumn<Glib::ustring> colStyle;
+    Gtk::TreeModelColumn<Glib::ustring> colFormat;
+    Gtk::TreeModelColumn<std::string> colPath;
+    Gtk::TreeModelColumn<long> colFaceIndex;
 };
 
-static
-const char* BlockCodeToString(int blockCode)
-{
-    // libicu does not seem to expose this data..
-    switch (blockCode)
-    {
-        default:  return "Unknown";
-        case  -1: return "Invalid Code";
-        case   0: return "No Block";
-        case   1: return "Basic Latin";
-        case   2: return "Latin-1 Supplement";
-        case   3: return "Latin Extended-A";
-        case   4: return "Latin Extended-B";
-        case   5: return "IPA Extensions";
-        case   6: return "Spacing Modifier Letters";
-        case   7: return "Combining Diacritical Marks";
-        case   8: return "Greek and Coptic";
-        case   9: return "Cyrillic";
-        case  10: return "Armenian";
-        case  11: return "Hebrew";
-        case  12: return "Arabic";
-        case  13: return "Syriac";
-        case  14: return "Thaana";
-        case  15: return "Devanagari";
-        case  16: return "Bengali";
-        case  17: return "Gurmukhi";
-        case  18: return "Gujarati";
-        case  19: return "Oriya";
-        case  20: return "Tamil";
-        case  21: return "Telugu";
-        case  22: return "Kannada";
-        case  23: return "Malayalam";
-        case  24: return "Sinhala";
-        case  25: return "Thai";
-        case  26: return "Lao";
-        case  27: return "Tibetan";
-        case  28: return "Myanmar";
-        case  29: return "Georgian";
-        case  30: return "Hangul Jamo";
-        case  31: return "Ethiopic";
-        case  32: return "Cherokee";
-        case  33: return "Unified Canadian Aboriginal Syllabics";
-        case  34: return "Ogham";
-        case  35: return "Runic";
-        case  36: return "Khmer";
-        case  37: return "Mongolian";
-        case  38: return "Latin Extended Additional";
-        case  39: return "Greek Extended";
-        case  40: return "General Punctuation";
-        case  41: return "Superscripts and Subscripts";
-        case  42: return "Currency Symbols";
-        case  43: return "Combining Diacritical Marks for Symbols";
-        case  44: return "Letterlike Symbols";
-        case  45: return "Number Forms";
-        case  46: return "Arrows";
-        case  47: return "Mathematical Operators";
-        case  48: return "Miscellaneous Technical";
-        case  49: return "Control Pictures";
-        case  50: return "Optical Character Recognition";
-        case  51: return "Enclosed Alphanumerics";
-        case  52: return "Box Drawing";
-        case  53: return "Block Elements";
-        case  54: return "Geometric Shapes";
-        case  55: return "Miscellaneous Symbols";
-        case  56: return "Dingbats";
-        case  57: return "Braille Patterns";
-        case  58: return "CJK Radicals Supplement";
-        case  59: return "Kangxi Radicals";
-        case  60: return "Ideographic Description Characters";
-        case  61: return "CJK Symbols and Punctuation";
-        case  62: return "Hiragana";
-        case  63: return "Katakana";
-        case  64: return "Bopomofo";
-        case  65: return "Hangul Compatibility Jamo";
-        case  66: return "Kanbun";
-        case  67: return "Bopomofo Extended";
-        case  68: return "Enclosed CJK Letters and Months";
-        case  69: return "CJK Compatibility";
-        case  70: return "CJK Unified Ideographs Extension A";
-        case  71: return "CJK Unified Ideographs";
-        case  72: return "Yi Syllables";
-        case  73: return "Yi Radicals";
-        case  74: return "Hangul Syllables";
-        case  75: return "High Surrogates";
-        case  76: return "High Private Use Surrogates";
-        case  77: return "Low Surrogates";
-        case  78: return "Private Use Area";
-        case  79: return "CJK Compatibility Ideographs";
-        case  80: return "Alphabetic Presentation Forms";
-        case  81: return "Arabic Presentation Forms-A";
-        case  82: return "Combining Half Marks";
-        case  83: return "CJK Compatibility Forms";
-        case  84: return "Small Form Variants";
-        case  85: return "Arabic Presentation Forms-B";
-        case  86: return "Specials";
-        case  87: return "Halfwidth and Fullwidth Forms";
-        case  88: return "Old Italic";
-        case  89: return "Gothic";
-        case  90: return "Deseret";
-        case  91: return "Byzantine Musical Symbols";
-        case  92: return "Musical Symbols";
-        case  93: return "Mathematical Alphanumeric Symbols";
-        case  94: return "CJK Unified Ideographs Extension B";
-        case  95: return "CJK Compatibility Ideographs Supplement";
-        case  96: return "Tags";
-        case  97: return "Cyrillic Supplement";
-        case  98: return "Tagalog";
-        case  99: return "Hanunoo";
-        case 100: return "Buhid";
-        case 101: return "Tagbanwa";
-        case 102: return "Miscellaneous Mathematical Symbols-A";
-        case 103: return "Supplemental Arrows-A";
-        case 104: return "Supplemental Arrows-B";
-        case 105: return "Miscellaneous Mathematical Symbols-B";
-        case 106: return "Supplemental Mathematical Operators";
-        case 107: return "Katakana Phonetic Extensions";
-        case 108: return "Variation Selectors";
-        case 109: return "Supplementary Private Use Area-A";
-        case 110: return "Supplementary Private Use Area-B";
-        case 111: return "Limbu";
-        case 112: return "Tai Le";
-        case 113: return "Khmer Symbols";
-        case 114: return "Phonetic Extensions";
-        case 115: return "Miscellaneous Symbols and Arrows";
-        case 116: return "Yijing Hexagram Symbols";
-        case 117: return "Linear B Syllabary";
-        case 118: return "Linear B Ideograms";
-        case 119: return "Aegean Numbers";
-        case 120: return "Ugaritic";
-        case 121: return "Shavian";
-        case 122: return "Osmanya";
-        case 123: return "Cypriot Syllabary";
-        case 124: return "Tai Xuan Jing Symbols";
-        case 125: return "Variation Selectors Supplement";
-        case 126: return "Ancient Greek Musical Notation";
-        case 127: return "Ancient Greek Numbers";
-        case 128: return "Arabic Supplement";
-        case 129: return "Buginese";
-        case 130: return "CJK Strokes";
-        case 131: return "Combining Diacritical Marks Supplement";
-        case 132: return "Coptic";
-        case 133: return "Ethiopic Extended";
-        case 134: return "Ethiopic Supplement";
-        case 135: return "Georgian";
-        case 136: return "Glagolitic";
-        case 137: return "Kharoshthi";
-        case 138: return "Modifier Tone Letters";
-        case 139: return "New Tai Lue";
-        case 140: return "Old Persian";
-        case 141: return "Phonetic Extensions Supplement";
-        case 142: return "Supplemental Punctuation";
-        case 143: return "Syloti Nagri";
-        case 144: return "Tifinagh";
-        case 145: return "Vertical Forms";
-        case 146: return "NKo";
-        case 147: return "Balinese";
-        case 148: return "Latin Extended-C";
-        case 149: return "Latin Extended-D";
-        case 150: return "Phags-pa";
-        case 151: return "Phoenician";
-        case 152: return "Cuneiform";
-        case 153: return "Cuneiform Numbers and Punctuation";
-        case 154: return "Counting Rod Numerals";
-        case 155: return "Sundanese";
-        case 156: return "Lepcha";
-        case 157: return "Ol Chiki";
-        case 158: return "Cyrillic Extended-A";
-        case 159: return "Vai";
-        case 160: return "Cyrillic Extended-B";
-        case 161: return "Saurashtra";
-        case 162: return "Kayah Li";
-        case 163: return "Rejang";
-        case 164: return "Cham";
-        case 165: return "Ancient Symbols";
-        case 166: return "Phaistos Disc";
-        case 167: return "Lycian";
-        case 168: return "Carian";
-        case 169: return "Lydian";
-        case 170: return "Mahjong Tiles";
-        case 171: return "Domino Tiles";
-        case 172: return "Samaritan";
-        case 173: return "Unified Canadian Aboriginal Syllabics Extended";
-        case 174: return "Tai Tham";
-        case 175: return "Vedic Extensions";
-        case 176: return "Lisu";
-        case 177: return "Bamum";
-        case 178: return "Common Indic Number Forms";
-        case 179: return "Devanagari Extended";
-        case 180: return "Hangul Jamo Extended-A";
-        case 181: return "Javanese";
-        case 182: return "Myanmar Extended-A";
-        case 183: return "Tai Viet";
-        case 184: return "Meetei Mayek";
-        case 185: return "Hangul Jamo Extended-B";
-        case 186: return "Imperial Aramaic";
-        case 187: return "Old South Arabian";
-        case 188: return "Avestan";
-        case 189: return "Inscriptional Parthian";
-        case 190: return "Inscriptional Pahlavi";
-        case 191: return "Old Turkic";
-        case 192: return "Rumi Numeral Symbols";
-        case 193: return "Kaithi";
-        case 194: return "Egyptian Hieroglyphs";
-        case 195: return "Enclosed Alphanumeric Supplement";
-        case 196: return "Enclosed Ideographic Supplement";
-        case 197: return "CJK Unified Ideographs Extension C";
-        case 198: return "Mandaic";
-        case 199: return "Batak";
-        case 200: return "Ethiopic Extended-A";
-        case 201: return "Brahmi";
-        case 202: return "Bamum Supplement";
-        case 203: return "Kana Supplement";
-        case 204: return "Playing Cards";
-        case 205: return "Miscellaneous Symbols and Pictographs";
-        case 206: return "Emoticons";
-        case 207: return "Transport and Map Symbols";
-        case 208: return "Alchemical Symbols";
-        case 209: return "CJK Unified Ideographs Extension D";
-        case 210: return "Arabic Extended-A";
-        case 211: return "Arabic Mathematical Alphabetic Symbols";
-        case 212: return "Chakma";
-        case 213: return "Meetei Mayek Extensions";
-        case 214: return "Meroitic Cursive";
-        case 215: return "Meroitic Hieroglyphs";
-        case 216: return "Miao";
-        case 217: return "Sharada";
-        case 218: return "Sora Sompeng";
-        case 219: return "Sundanese Supplement";
-        case 220: return "Takri";
-        case 221: return "Bassa Vah";
-        case 222: return "Caucasian Albanian";
-        case 223: return "Coptic Epact Numbers";
-        case 224: return "Combining Diacritical Marks Extended";
-        case 225: return "Duployan";
-        case 226: return "Elbasan";
-        case 227: return "Geometric Shapes";
-        case 228: return "Grantha";
-        case 229: return "Khojki";
-        case 230: return "Khudawadi";
-        case 231: return "Latin Extended-E";
-        case 232: return "Linear A";
-        case 233: return "Mahajani";
-        case 234: return "Manichaean";
-        case 235: return "Mende Kikakui";
-        case 236: return "Modi";
-        case 237: return "Mro";
-        case 238: return "Myanmar Extended-B";
-        case 239: return "Nabataean";
-        case 240: return "Old North Arabian";
-        case 241: return "Old Permic";
-        case 242: return "Ornamental Dingbats";
-        case 243: return "Pahawh Hmong";
-        case 244: return "Palmyrene";
-        case 245: return "Pau Cin Hau";
-        case 246: return "Psalter Pahlavi";
-        case 247: return "Shorthand Format Controls";
-        case 248: return "Siddham";
-        case 249: return "Sinhala Archaic Numbers";
-        case 250: return "Supplemental Arrows-C";
-        case 251: return "Tirhuta";
-        case 252: return "Warang Citi";
-        case 253: return "Ahom";
-        case 254: return "Anatolian Hieroglyphs";
-        case 255: return "Cherokee Supplement";
-        case 256: return "CJK Unified Ideographs Extension E";
-        case 257: return "Early Dynastic Cuneiform";
-        case 258: return "Hatran";
-        case 259: return "Multani";
-        case 260: return "Old Hungarian";
-        case 261: return "Supplemental Symbols and Pictographs";
-        case 262: return "Sutton SignWriting";
-        case 263: return "Adlam";
-        case 264: return "Bhaiksuki";
-        case 265: return "Cyrillic Extended-C";
-        case 266: return "Glagolitic Supplement";
-        case 267: return "Ideographic Symbols and Punctuation";
-        case 268: return "Marchen";
-        case 269: return "Mongolian Supplement";
-        case 270: return "Newa";
-        case 271: return "Osage";
-        case 272: return "Tangut";
-        case 273: return "Tangut Components";
-        case 274: return "CJK Unified Ideographs Extension F";
-        case 275: return "Kana Extended-A";
-        case 276: return "Masaram Gondi";
-        case 277: return "Nushu";
-        case 278: return "Soyombo";
-        case 279: return "Syriac Supplement";
-        case 280: return "Zanabazar Square";
-        case 281: return "Chess Symbols";
-        case 282: return "Dogra";
-        case 283: return "Georgian";
-        case 284: return "Gunjala Gondi";
-        case 285: return "Hanifi Rohingya";
-        case 286: return "Indic Siyaq Numbers";
-        case 287: return "Makasar";
-        case 288: return "Mayan Numerals";
-        case 289: return "Medefaidrin";
-        case 290: return "Old Sogdian";
-        case 291: return "Sogdian";
-        case 292: return "Egyptian Hieroglyph Format Controls";
-        case 293: return "Elymaic";
-        case 294: return "Nandinagari";
-        case 295: return "Nyiakeng Puachue Hmong";
-        case 296: return "Ottoman Siyaq Numbers";
-        case 297: return "Small Kana Extension";
-        case 298: return "Symbols and Pictographs Extended-A";
-        case 299: return "Tamil Supplement";
-        case 300: return "Wancho";
-        case 301: return "Chorasmian";
-        case 302: return "CJK Unified Ideographs Extension G";
-        case 303: return "Dives Akuru";
-        case 304: return "Khitan Small Script";
-        case 305: return "Lisu Supplement";
-        case 306: return "Symbols for Legacy Computing";
-        case 307: return "Tangut Supplement";
-        case 308: return "Yezidi";
-    }
-}
+// Search results are expanded up to this many rows, more would be slow to lay out
+static const size_t kExpandedSearchResults = 2000;
 
 struct FontDebug : public Gtk::Window
 {
@@ -433,6 +126,22 @@ struct FontDebug : public Gtk::Window
     {
         if (FT_Init_FreeType(&_ft)) throw std::runtime_error("FT_Init_FreeType");
 
+        m_renderDispatcher.connect([this]()
+        {
+            worker_notified();
+        });
+
+        m_searchDispatcher.connect([this]()
+        {
+            auto index = m_searchIndexer.takeResult();
+            if (!index || index->face() != m_faceInfo) return;
+
+            m_searchIndex = index;
+            for (const auto &f : m_onSearchIndexReady) {
+                f();
+            }
+        });
+
         set_border_width(5);
 
         {
@@ -449,6 +158,32 @@ struct FontDebug : public Gtk::Window
 
 
             auto menuu = menu({
+                menuItem("Debug", menu({
+                    checkMenuItem("Per-pixel Bitmap Drawing", false, [this](bool active)
+                    {
+                        m_drawer->m_drawPerPixel = active;
+                        m_drawer->queue_draw();
+                    }),
+                    checkMenuItem("Log Frame Times", false, [this](bool active)
+                    {
+                        m_drawer->m_logFrameTimes = active;
+                        m_drawer->queue_draw();
+                    }),
+                    checkMenuItem("Timing Overlay", false, [this](bool active)
+                    {
+                        m_renderWorker.setTimingEnabled(active);
+                        m_drawer->setTimingOverlay(active);
+                    }),
+                    checkMenuItem("Record Trace", traceEnabled(), [](bool active)
+                    {
+                        setTraceEnabled(active);
+                    }),
+                    menuItem("Save Trace...", [this]()
+                    {
+                        saveTrace();
+                    }),
+                })),
+                separatorMenuItem(),
                 menuItem("About", [this](){
                     Gtk::AboutDialog abt;
 
@@ -486,26 +221,32 @@ struct FontDebug : public Gtk::Window
             set_titlebar(*hdrbar);
         }
 
-        // TODO better default font search?
-        for (const auto &p : std::filesystem::recursive_directory_iterator("/usr/share/fonts"))
+        // The index left by the last run picks the default font right away,
+        // the scan started by m_fontScanner refreshes it in the background
+        m_fontIndex = std::make_shared<const FontIndex>(loadFontIndex(fontIndexCachePath()));
+        pickDefaultFont();
+
+        m_fontScanDispatcher.connect([this]()
         {
-            std::string path = p.path();
-            size_t idx = path.rfind('.');
-            if (idx == std::string::npos) continue;
+            auto index = m_fontScanner.takeResult();
+            if (!index) return;
 
-            std::string extension = path.substr(idx);
-            if (extension == ".ttf" || extension == ".otf")
-            {
-                std::string name = path.substr(path.rfind('/') + 1);
+            m_fontIndex = index;
+            for (const auto &f : m_onFontIndexUpdated) {
+                f();
+            }
 
-                if (m_selectedFontName == "" || name == "DejaVuSans.ttf")
+            if (m_selectedFontPath.empty())
+            {
+                pickDefaultFont();
+                if (m_selectedFontPath.empty())
                 {
-                    m_selectedFontName = name;
-                    m_selectedFontPath = path;
+                    std::cerr << "No font found\n";
+                    return;
                 }
+                font_redraw();
             }
-        }
-        if (m_selectedFontName == "") throw std::runtime_error("No font found");
+        });
 
         auto *paned2 = Gtk::make_managed<Gtk::Paned>();
         paned2->show();
@@ -522,7 +263,7 @@ struct FontDebug : public Gtk::Window
         this->add(*mainGrid);
 
 
-        m_drawer = Gtk::make_managed<FreetypeBitmapDrawer>(_face, signals);
+        m_drawer = Gtk::make_managed<FreetypeBitmapDrawer>(signals);
         m_drawer->set_margin_start(5);
         m_drawer->set_margin_end(5);
         m_drawer->set_margin_top(5);
@@ -530,8 +271,9 @@ struct FontDebug : public Gtk::Window
 
         m_drawer->show();
         paned2->pack1(*m_drawer, true, false);
-        m_onFontReload.push_back([this](FT_Face)
+        m_onFontReload.push_back([this](const RenderedGlyphPtr &glyph)
         {
+            m_drawer->setGlyph(glyph);
             m_drawer->pointSelected = false;
             signals.pixel_selected.emit(-1, 0);
             m_drawer->queue_draw();
@@ -594,6 +336,70 @@ private:
     }
 
 
+    void selectFont(const std::string &path, FT_Long faceIndex)
+    {
+        m_selectedFontPath = path;
+        m_selectedFaceIndex = faceIndex;
+        m_selectedFontName = fontName(path, faceIndex);
+        if (m_fontButton)
+        {
+            m_fontButton->set_label(m_selectedFontName);
+        }
+        font_redraw();
+    }
+
+    // File name, plus the face for faces of collections after the first
+    static std::string fontName(const std::string &path, FT_Long faceIndex)
+    {
+        std::string name = path.substr(path.rfind('/') + 1);
+        if (faceIndex > 0) name += " #" + std::to_string(faceIndex);
+        return name;
+    }
+
+    // DejaVuSans.ttf if it is indexed, otherwise the first indexed font
+    void pickDefaultFont()
+    {
+        for (const FontIndexEntry &font : *m_fontIndex)
+        {
+            std::string name = font.path.substr(font.path.rfind('/') + 1);
+
+            if (m_selectedFontName == "" || name == "DejaVuSans.ttf")
+            {
+                m_selectedFontName = fontName(font.path, font.faceIndex);
+                m_selectedFontPath = font.path;
+                m_selectedFaceIndex = font.faceIndex;
+            }
+        }
+
+        if (m_fontButton)
+        {
+            m_fontButton->set_label(m_selectedFontName);
+        }
+    }
+
+    // Writes the events recorded so far as Chrome trace-event JSON
+    void saveTrace()
+    {
+        Gtk::FileChooserDialog dialog("Save Trace", Gtk::FILE_CHOOSER_ACTION_SAVE);
+        dialog.set_transient_for(*this);
+        dialog.set_current_name("fontdebug-trace.json");
+        dialog.set_do_overwrite_confirmation(true);
+
+        dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+        dialog.add_button("_Save", Gtk::RESPONSE_OK);
+
+        if (dialog.run() != Gtk::RESPONSE_OK) return;
+
+        try
+        {
+            writeTrace(dialog.get_filename());
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Saving trace failed: " << e.what() << "\n";
+        }
+    }
+
     bool pickFont()
     {
         Gtk::FileChooserDialog dialog("Choose Font", Gtk::FILE_CHOOSER_ACTION_OPEN);
@@ -612,6 +418,7 @@ private:
         if (dialog.run() == Gtk::RESPONSE_OK)
         {
             m_selectedFontPath = dialog.get_filename();
+            m_selectedFaceIndex = 0;
             size_t idx = m_selectedFontPath.rfind('/');
             m_selectedFontName = m_selectedFontPath.substr(idx+1);
             return true;
@@ -637,6 +444,146 @@ private:
         return *sep;
     }
 
+    // Fonts from the discovery index, a face is only opened once its row is picked
+    Gtk::Widget& makeFontBrowser()
+    {
+        auto *grid = Gtk::make_managed<Gtk::Grid>();
+        grid->set_row_spacing(3);
+        grid->set_column_spacing(3);
+        grid->show();
+
+        auto *search = Gtk::make_managed<Gtk::SearchEntry>();
+        search->set_placeholder_text("Search fonts");
+        search->set_hexpand(true);
+        search->show();
+        grid->attach(*search, 0, 0, 2, 1);
+
+        auto *styleCombo = Gtk::make_managed<Gtk::ComboBoxText>();
+        styleCombo->show();
+        grid->attach(*styleCombo, 0, 1);
+
+        auto *formatCombo = Gtk::make_managed<Gtk::ComboBoxText>();
+        formatCombo->append("", "All formats");
+        for (const char *format : { "TrueType", "OpenType", "Collection", "WOFF", "WOFF2", "PCF" })
+        {
+            formatCombo->append(format, format);
+        }
+        formatCombo->set_active_id("");
+        formatCombo->show();
+        grid->attach(*formatCombo, 1, 1);
+
+        auto store = Gtk::ListStore::create(m_fontColumns);
+        auto filter = Gtk::TreeModelFilter::create(store);
+
+        // Lower case search words, refreshed when the query changes
+        auto words = std::make_shared<std::vector<std::string>>();
+        auto lower = [](std::string s)
+        {
+            std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return tolower(c); });
+            return s;
+        };
+
+        filter->set_visible_func([this, words, lower, styleCombo, formatCombo](const Gtk::TreeModel::const_iterator &it)
+        {
+            const Gtk::TreeModel::Row &row = *it;
+
+            std::string style = row.get_value(m_fontColumns.colStyle);
+            if (!styleCombo->get_active_id().empty() && style != styleCombo->get_active_id()) return false;
+
+            std::string format = row.get_value(m_fontColumns.colFormat);
+            if (!formatCombo->get_active_id().empty() && format != formatCombo->get_active_id()) return false;
+
+            std::string path = row.get_value(m_fontColumns.colPath);
+            std::string text = lower(row.get_value(m_fontColumns.colFamily) + " " + style + " " + path.substr(path.rfind('/') + 1));
+            for (const std::string &word : *words)
+            {
+                if (text.find(word) == std::string::npos) return false;
+            }
+            return true;
+        });
+
+        search->signal_changed().connect([search, words, lower, filter]()
+        {
+            words->clear();
+            std::istringstream ss(lower(search->get_text()));
+            std::string word;
+            while (ss >> word)
+            {
+                words->push_back(word);
+            }
+            filter->refilter();
+        });
+        styleCombo->signal_changed().connect([filter]() { filter->refilter(); });
+        formatCombo->signal_changed().connect([filter]() { filter->refilter(); });
+
+        auto *view = Gtk::make_managed<Gtk::TreeView>(filter);
+        view->append_column("Family", m_fontColumns.colFamily);
+        view->append_column("Style", m_fontColumns.colStyle);
+        view->append_column("Format", m_fontColumns.colFormat);
+        view->set_tooltip_column(m_fontColumns.colPath.index());
+        view->set_enable_search(false);
+        view->show();
+
+        view->signal_cursor_changed().connect([this, view, filter]()
+        {
+            Gtk::TreeModel::Path path;
+            Gtk::TreeViewColumn *col;
+            view->get_cursor(path, col);
+
+            Gtk::TreeModel::iterator it = filter->get_iter(path);
+            if (!it) return;
+
+            std::string fontPath = it->get_value(m_fontColumns.colPath);
+            FT_Long faceIndex = it->get_value(m_fontColumns.colFaceIndex);
+            if (fontPath != m_selectedFontPath || faceIndex != m_selectedFaceIndex)
+            {
+                selectFont(fontPath, faceIndex);
+            }
+        });
+
+        auto *scrolled = Gtk::make_managed<Gtk::ScrolledWindow>();
+        scrolled->add(*view);
+        scrolled->set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        scrolled->set_size_request(-1, 200);
+        scrolled->set_hexpand();
+        scrolled->show();
+        grid->attach(*scrolled, 0, 2, 2, 1);
+
+        m_onFontIndexUpdated.push_back([this, store, styleCombo]()
+        {
+            std::set<std::string> styles;
+
+            store->clear();
+            for (const FontIndexEntry &font : *m_fontIndex)
+            {
+                std::string file = font.path.substr(font.path.rfind('/') + 1);
+
+                Gtk::TreeModel::Row row = *store->append();
+                row[m_fontColumns.colFamily] = font.family.empty() ? file : font.family;
+                row[m_fontColumns.colStyle] = font.style;
+                row[m_fontColumns.colFormat] = fontFormatName(font.path);
+                row[m_fontColumns.colPath] = font.path;
+                row[m_fontColumns.colFaceIndex] = font.faceIndex;
+                styles.insert(font.style);
+            }
+
+            std::string activeStyle = styleCombo->get_active_id();
+            styleCombo->remove_all();
+            styleCombo->append("", "All styles");
+            for (const std::string &style : styles)
+            {
+                if (!style.empty()) styleCombo->append(style, style);
+            }
+            if (!styleCombo->set_active_id(activeStyle))
+            {
+                styleCombo->set_active_id("");
+            }
+        });
+        m_onFontIndexUpdated.back()();
+
+        return *grid;
+    }
+
     Gtk::Widget& makeConfigGrid()
     {
         auto *cfgGrid = Gtk::make_managed<Gtk::Grid>();
@@ -650,119 +597,161 @@ private:
         cfgGrid->show();
         cfgGrid->set_column_spacing(5);
 
+        cfgGrid->attach(makeBoldLabel("Fonts"), 1, curRow++);
+        cfgGrid->attach(makeFontBrowser(), 1, curRow++);
+
         cfgGrid->attach(makeBoldLabel("Glyphs"), 1, curRow++);
 
         {
             auto *m_ScrolledWindow = Gtk::make_managed<Gtk::ScrolledWindow>();
             auto *m_TreeView = Gtk::make_managed<Gtk::TreeView>();
+            m_glyphTreeView = m_TreeView;
 
             m_ScrolledWindow->add(*m_TreeView);
             m_ScrolledWindow->set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
 
-            Glib::RefPtr<Gtk::TreeStore> fontGlyphsModel = Gtk::TreeStore::create(columns);
+            auto *m_LoadProgress = Gtk::make_managed<Gtk::ProgressBar>();
+            m_LoadProgress->set_show_text(true);
 
-            m_onFaceReload.push_back([this, fontGlyphsModel, m_TreeView](FT_Face face)
+            auto *m_SearchEntry = Gtk::make_managed<Gtk::SearchEntry>();
+            m_SearchEntry->set_placeholder_text("Search names or U+XXXX");
+            m_SearchEntry->set_sensitive(false);
+            m_SearchEntry->show();
+
+            // The list starts empty and fills as the worker streams the charmap in
+            m_onFaceReload.push_back([this, m_TreeView, m_LoadProgress, m_SearchEntry](const FaceInfo &)
             {
                 beingCleared = true;
-                fontGlyphsModel->clear();
+                m_glyphListModel = GlyphListModel::create(std::make_shared<GlyphList>());
+                m_TreeView->set_model(m_glyphListModel);
+                m_SearchEntry->set_text("");
                 beingCleared = false;
 
-                // Char picking logic, highest is preferable
-                // 1 - Pick first non-control charcode in the font
-                // 2 - Default char 'A' is available, pick that
-                // 3 - m_charCode (from last font) is available, pick that
-                int charSelectionType = 0;
-                int charSelection = -1;
+                // Searching waits for the index, built once the whole charmap is listed
+                m_searchIndex = nullptr;
+                m_SearchEntry->set_sensitive(false);
 
-                int lastBlockCode = -2;
-                Gtk::TreeModel::Row lastBlockRow;
+                m_rowSelectionPending = true;
+                m_LoadProgress->set_fraction(0);
+                m_LoadProgress->set_text("Loading glyphs");
+                m_LoadProgress->show();
+            });
 
-                FT_UInt gindex;
-                FT_ULong charCode = FT_Get_First_Char(face, &gindex);
-                while (gindex != 0)
+            m_onCharMapChunk.push_back([this, m_LoadProgress](const CharMapChunk &chunk)
+            {
+                m_glyphListModel->append(chunk.entries);
+
+                const GlyphList &list = m_glyphListModel->list();
+                if (m_rowSelectionPending && m_charCode >= 0 && list.find(m_charCode))
                 {
-                    char charNameBuf[100];
-                    UErrorCode errorCode = U_ZERO_ERROR;
-                    u_charName(charCode, U_EXTENDED_CHAR_NAME, charNameBuf, sizeof(charNameBuf), &errorCode);
-                    if (errorCode != U_ZERO_ERROR) throw std::runtime_error("u_charName");
+                    m_rowSelectionPending = false;
+                    selectGlyphRow(m_charCode);
+                }
 
-                    int blockCode = ublock_getCode(charCode);
+                if (chunk.last)
+                {
+                    m_rowSelectionPending = false;
+                    m_LoadProgress->hide();
 
-                    if (blockCode != lastBlockCode)
+                    std::vector<uint32_t> charCodes;
+                    charCodes.reserve(list.entries.size());
+                    for (const GlyphListEntry &entry : list.entries)
                     {
-                        lastBlockCode = blockCode;
-                        lastBlockRow = *(fontGlyphsModel->append());
-                        lastBlockRow[columns.colName] = BlockCodeToString(blockCode);
-                        lastBlockRow[columns.colCharCodeInt] = -1;
+                        charCodes.push_back(entry.charCode);
                     }
+                    m_searchIndexer.post(chunk.face, std::move(charCodes));
+                    return;
+                }
 
-                    auto rowIt = fontGlyphsModel->append(lastBlockRow.children());
-                    (*rowIt)[columns.colCode] = std::to_string(charCode);
-                    (*rowIt)[columns.colName] = charNameBuf;
-                    (*rowIt)[columns.colCharCodeInt] = charCode;
+                // num_glyphs is only an estimate of the charmap size
+                double fraction = (double)list.entries.size() / std::max<FT_Long>(1, chunk.face->num_glyphs);
+                m_LoadProgress->set_fraction(std::min(1.0, fraction));
+                m_LoadProgress->set_text("Loading glyphs (" + std::to_string(list.entries.size()) + ")");
+            });
 
-                    charCode = FT_Get_Next_Char(face, charCode, &gindex);
+            m_TreeView->append_column("ID", columns.colCode);
+            m_TreeView->append_column("Name", columns.colName);
 
-                    auto selectChar = [&](int selectionType, int charCode) {
-                        charSelectionType = selectionType;
-                        charSelection = charCode;
-                    };
+            // Fixed row heights let the view skip measuring rows it does not show
+            m_TreeView->get_column(0)->set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
+            m_TreeView->get_column(0)->set_fixed_width(80);
+            m_TreeView->get_column(1)->set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
+            m_TreeView->get_column(1)->set_expand(true);
+            m_TreeView->set_fixed_height_mode(true);
+            m_TreeView->show();
+            m_ScrolledWindow->show();
 
-                    if (charSelectionType < 1 && charCode > 32) {
-                        selectChar(1, charCode);
-                    }
-                    if (charSelectionType < 2 && charCode == 'A') {
-                        selectChar(2, charCode);
-                    }
-                    if (charSelectionType < 3 && charCode == m_charCode) {
-                        selectChar(3, charCode);
-                    }
+
+            m_onSearchIndexReady.push_back([m_SearchEntry]()
+            {
+                m_SearchEntry->set_sensitive(true);
+            });
+
+            m_SearchEntry->signal_changed().connect([this, m_TreeView, m_SearchEntry]()
+            {
+                if (beingCleared || !m_searchIndex) return;
+
+                std::string query = m_SearchEntry->get_text();
+                if (query.find_first_not_of(' ') == std::string::npos)
+                {
+                    beingCleared = true;
+                    m_TreeView->set_model(m_glyphListModel);
+                    beingCleared = false;
+                    selectGlyphRow(m_charCode);
+                    return;
                 }
 
-                m_charCode = charSelection;
+                const GlyphList &list = m_glyphListModel->list();
+                std::vector<CharMapEntry> matches;
+                for (uint32_t charCode : m_searchIndex->search(query))
+                {
+                    matches.push_back({ charCode, list.find(charCode)->glyphIndex });
+                }
 
+                beingCleared = true;
+                m_TreeView->set_model(GlyphListModel::create(std::make_shared<GlyphList>(makeGlyphList(matches))));
+                if (matches.size() <= kExpandedSearchResults)
+                {
+                    m_TreeView->expand_all();
+                }
+                beingCleared = false;
 
-                // Rescan the tree and find the selected glyph
-                // Storing a refence to glyph row and selecting that is simpler
-                // but doing that selects the row above and I can't figure out why
-                std::string charCodeStr = std::to_string(m_charCode);
-                for (Gtk::TreeRow groupRow : fontGlyphsModel->children())
+                // A query like "U+1F600" or "0x41" jumps straight to that char
+                std::string code = query.substr(query.find_first_not_of(' '));
+                if (code.size() > 2 && (code.compare(0, 2, "U+") == 0 || code.compare(0, 2, "u+") == 0 || code.compare(0, 2, "0x") == 0))
                 {
-                    for (Gtk::TreeRow glyphRow : groupRow.children())
+                    char *end;
+                    unsigned long charCode = strtoul(code.c_str() + 2, &end, 16);
+                    if (*end == '\0' && list.find(charCode) && (int)charCode != m_charCode)
                     {
-                        if (charCodeStr == glyphRow.get_value(columns.colCode))
-                        {
-                            auto path = fontGlyphsModel->get_path(glyphRow);
-                            m_TreeView->expand_to_path(path);
-                            m_TreeView->scroll_to_row(path);
-                            m_TreeView->get_selection()->select(path); // TODO XXX this causes double redraw
-                        }
+                        m_charCode = charCode;
+                        font_redraw();
                     }
                 }
-            });
-
-            m_TreeView->set_model(fontGlyphsModel);
-
-            m_TreeView->append_column("ID", columns.colCode);
-            m_TreeView->append_column("Name", columns.colName);
-            m_TreeView->show();
-            m_ScrolledWindow->show();
 
+                selectGlyphRow(m_charCode);
+            });
 
+            cfgGrid->attach(*m_SearchEntry, 1, curRow++);
             cfgGrid->attach(*m_ScrolledWindow, 1, curRow++);
+            cfgGrid->attach(*m_LoadProgress, 1, curRow++);
 
-            m_TreeView->signal_cursor_changed().connect([this, m_TreeView, fontGlyphsModel]()
+            m_TreeView->signal_cursor_changed().connect([this, m_TreeView]()
             {
-                if (beingCleared) return;
+                auto model = Glib::RefPtr<GlyphListModel>::cast_dynamic(m_TreeView->get_model());
+                if (beingCleared || !model) return;
                 Gtk::TreeModel::Path path;
                 Gtk::TreeViewColumn *col;
                 m_TreeView->get_cursor(path, col);
 
-                Gtk::TreeModel::Row selectedRow = *(fontGlyphsModel->get_iter(path));
-                int charCode = selectedRow.get_value(columns.colCharCodeInt);
+                Gtk::TreeModel::iterator it = model->get_iter(path);
+                if (!it) return;
+
+                int charCode = it->get_value(columns.colCharCodeInt);
                 if (charCode != -1 && charCode != m_charCode)
                 {
                     m_charCode = charCode;
+                    m_rowSelectionPending = false;
                     font_redraw();
                 }
             });
@@ -800,17 +789,12 @@ private:
         {
             auto *fontBox = Gtk::make_managed<Gtk::Button>();
             fontBox->set_label(m_selectedFontName);
+            m_fontButton = fontBox;
             fontBox->signal_clicked().connect([this, fontBox]()
             {
                 if (pickFont())
                 {
                     fontBox->set_label(m_selectedFontName);
-                    if (_face != nullptr)
-                    {
-                        if (FT_Done_Face(_face)) throw std::runtime_error("FT_Done_Face");
-                        _face = nullptr;
-                    }
-
                     font_redraw();
                 }
             });
@@ -1269,64 +1253,162 @@ private:
         return *wGrid;
     }
 
+    // Schedules a render of the current state on the next frame clock tick.
+    // Changes arriving before that tick (slider drags, spin buttons) share a
+    // single render and their intermediate states are dropped.
     void font_redraw()
     {
-        if (_face == nullptr)
+        TRACE_SCOPE("ui", "font_redraw");
+
+        // Nothing to render until the font scan finds a font
+        if (m_selectedFontPath.empty()) return;
+
+        if (m_renderScheduled)
         {
-            if (FT_New_Face(_ft, m_selectedFontPath.c_str(), 0, &_face)) throw std::runtime_error("FT_New_Face");
-            for (const auto &f : m_onFaceReload) {
-                f(_face);
-            }
+            ++m_stats.rendersCoalesced;
+            return;
+        }
 
-            hasFixedSizes = bool(_face->num_fixed_sizes);
-            for (int i = 0; i < _face->num_fixed_sizes; ++i) {
-                auto &sz = _face->available_sizes[i];
-                std::cerr << sz.height << " " << sz.width << " " << sz.size << " " << sz.x_ppem << " " << sz.y_ppem << "\n";
-            }
+        m_renderScheduled = true;
+        m_drawer->add_tick_callback([this](const Glib::RefPtr<Gdk::FrameClock>&)
+        {
+            m_renderScheduled = false;
+            post_render();
+            return false;
+        });
+    }
+
+    // Moves the glyph list cursor to `charCode` without triggering a render
+    void selectGlyphRow(int charCode)
+    {
+        // Either the full list or search results
+        auto model = Glib::RefPtr<GlyphListModel>::cast_dynamic(m_glyphTreeView->get_model());
+        if (!model || charCode < 0) return;
+
+        Gtk::TreeModel::Path path = model->pathOf(charCode);
+        if (path.empty()) return;
+
+        beingCleared = true;
+        m_glyphTreeView->expand_to_path(path);
+        m_glyphTreeView->set_cursor(path);
+        m_glyphTreeView->scroll_to_row(path);
+        beingCleared = false;
+    }
+
+    // Posts the current state to the render worker, result arrives in worker_notified()
+    void post_render()
+    {
+        TRACE_SCOPE("ui", "post_render");
+
+        RenderRequest request;
+        request.fontPath = m_selectedFontPath;
+        request.faceIndex = m_selectedFaceIndex;
+        request.charCode = m_charCode;
+        request.charSize = m_charSize;
+        // Hint for the mode the glyph is rendered in, as FreeType
+        // recommends. The glyph cache also only serves matching targets.
+        request.loadFlags = m_loadFlags | FT_LOAD_TARGET_(m_renderMode);
+        request.renderMode = m_renderMode;
+
+        request.matrix.xx = round(m_glyphTransform.xx * 65536.0);
+        request.matrix.xy = round(m_glyphTransform.xy * 65536.0);
+        request.matrix.yx = round(m_glyphTransform.yx * 65536.0);
+        request.matrix.yy = round(m_glyphTransform.yy * 65536.0);
+        request.delta.x   = round(m_glyphTransform.x0 * 64.0);
+        request.delta.y   = round(m_glyphTransform.y0 * 64.0);
+
+        m_renderWorker.post(std::move(request));
+
+        ++m_stats.rendersPosted;
+        signals.stats_updated.emit(m_stats);
+    }
+
+    void worker_notified()
+    {
+        TRACE_SCOPE("ui", "worker_notified");
+
+        // Before the result, which may have failed, and the new face's chunks
+        if (auto faceSwitch = m_renderWorker.takeFaceSwitch())
+        {
+            face_switched(*faceSwitch);
         }
 
-        if (hasFixedSizes)
+        RenderedGlyphPtr glyph;
+        try
         {
-            FT_Select_Size(_face, 0);
+            glyph = m_renderWorker.takeResult();
         }
-        else
+        catch (const std::exception &e)
         {
-            FT_Set_Char_Size(_face, m_charSize*64, m_charSize*64, 0, 0);
+            std::cerr << "Rendering failed: " << e.what() << "\n";
         }
 
+        if (glyph)
         {
-            FT_Matrix matrix = {};
-            FT_Vector vector = {};
-            matrix.xx = round(m_glyphTransform.xx * 65536.0);
-            matrix.xy = round(m_glyphTransform.xy * 65536.0);
-            matrix.yx = round(m_glyphTransform.yx * 65536.0);
-            matrix.yy = round(m_glyphTransform.yy * 65536.0);
-            vector.x  = round(m_glyphTransform.x0 * 64.0);
-            vector.y  = round(m_glyphTransform.y0 * 64.0);
-
-            FT_Set_Transform(_face, &matrix, &vector);
+            std::chrono::steady_clock::time_point lap;
+            if (m_drawer->timingOverlay()) lap = std::chrono::steady_clock::now();
+
+            glyph_rendered(glyph);
+
+            if (m_drawer->timingOverlay())
+            {
+                double fanOutTime = 0;
+                addLapTime(lap, fanOutTime);
+                m_drawer->setRenderTimings(m_renderWorker.renderTimings(), fanOutTime);
+            }
         }
 
-        FT_Error errorCode = FT_Load_Char(_face, m_charCode, m_loadFlags);
-        if (errorCode) throw FreetypeError(errorCode, "FT_Load_Char");
-        errorCode = FT_Render_Glyph(_face->glyph, m_renderMode);
-        if (errorCode)
+        m_stats.faceCache = m_renderWorker.faceCacheStats();
+        m_stats.glyphCache = m_renderWorker.glyphCacheStats();
+        m_stats.resultCache = m_renderWorker.resultCacheStats();
+        signals.stats_updated.emit(m_stats);
+
+        for (const CharMapChunk &chunk : m_renderWorker.takeCharMapChunks())
         {
-            // On FT-2.11.0, NotoColorEmoji.ttf seems to return error 19, but render fine??, TODO
-            // throw FreetypeError(errorCode, "FT_Render_Glyph");
-            std::cerr << "Failed rendering char " << m_charCode << " error code " << errorCode << "\n";
+            // Leftovers of a walk that was replaced before it finished
+            if (chunk.walk != m_charMapWalk) continue;
+
+            for (const auto &f : m_onCharMapChunk) {
+                f(chunk);
+            }
+        }
+    }
+
+    void face_switched(const FaceSwitch &faceSwitch)
+    {
+        TRACE_SCOPE("ui", "m_onFaceReload");
+
+        m_faceInfo = faceSwitch.face;
+        m_charMapWalk = faceSwitch.walk;
+
+        // The worker swaps in a char the new face has when it lacks the requested one
+        m_charCode = (int)faceSwitch.charCode;
+
+        for (const auto &f : m_onFaceReload) {
+            f(*m_faceInfo);
         }
+    }
+
+    void glyph_rendered(const RenderedGlyphPtr &glyph)
+    {
+        TRACE_SCOPE("ui", "glyph_rendered");
 
-        for (const auto &f : m_onFontReload) {
-            f(_face);
+        m_glyph = glyph;
+        {
+            TRACE_SCOPE("ui", "m_onFontReload");
+            for (const auto &f : m_onFontReload) {
+                f(m_glyph);
+            }
         }
 
-        signals.font_reloaded.emit(_face);
+        signals.font_reloaded.emit(*m_glyph);
     }
 
     Signals signals;
+    Stats m_stats;
 
     FontGlyphSelectorColumns columns;
+    FontListColumns m_fontColumns;
     int m_charCode = -1;
     int m_charSize = 13;
     int m_loadFlags = 0;
@@ -1338,22 +1420,72 @@ private:
     FT_Render_Mode m_renderMode = FT_RENDER_MODE_LCD;
 
     std::string m_selectedFontPath;
+    // Face of m_selectedFontPath, for collections
+    FT_Long m_selectedFaceIndex = 0;
     std::string m_selectedFontName;
+    Gtk::Button *m_fontButton = nullptr;
+
+    std::shared_ptr<const FontIndex> m_fontIndex;
 
     FT_Library _ft;
-    FT_Face _face = nullptr;
 
-    bool hasFixedSizes = false;
-    bool beingCleared = false;
+    std::shared_ptr<const FaceInfo> m_faceInfo;
+    // Charmap walk of m_faceInfo whose chunks fill the glyph list
+    uint64_t m_charMapWalk = 0;
+    RenderedGlyphPtr m_glyph;
+
+    // Full list of the current face, the view may show search results instead
+    Glib::RefPtr<GlyphListModel> m_glyphListModel;
+    std::shared_ptr<const GlyphSearchIndex> m_searchIndex;
+    Gtk::TreeView *m_glyphTreeView = nullptr;
 
-    std::vector<std::function<void(FT_Face)>> m_onFaceReload;
-    std::vector<std::function<void(FT_Face)>> m_onFontReload;
+    bool beingCleared = false;
+    bool m_renderScheduled = false;
+    // Select m_charCode in the glyph list once its row has been streamed in
+    bool m_rowSelectionPending = false;
+
+    std::vector<std::function<void(const FaceInfo&)>> m_onFaceReload;
+    std::vector<std::function<void(const CharMapChunk&)>> m_onCharMapChunk;
+    std::vector<std::function<void()>> m_onSearchIndexReady;
+    std::vector<std::function<void()>> m_onFontIndexUpdated;
+    std::vector<std::function<void(const RenderedGlyphPtr&)>> m_onFontReload;
+
+    // Declared last, the worker threads are joined before anything they notify is destroyed
+    Glib::Dispatcher m_renderDispatcher;
+    Glib::Dispatcher m_searchDispatcher;
+    Glib::Dispatcher m_fontScanDispatcher;
+    RenderWorker m_renderWorker{[this]() { m_renderDispatcher.emit(); }};
+    GlyphSearchIndexer m_searchIndexer{[this]() { m_searchDispatcher.emit(); }};
+    FontScanner m_fontScanner{[this]() { m_fontScanDispatcher.emit(); }};
 };
 
 int main(int argc, char** argv)
 {
+    setTraceThreadName("main");
+
+    // Records the whole session and writes it on exit
+    const char *tracePath = getenv("FONTDEBUG_TRACE");
+    if (tracePath && *tracePath) setTraceEnabled(true);
+
     Glib::RefPtr<Gtk::Application> app = Gtk::Application::create(argc, argv);
-    FontDebug win;
-    return app->run(win);
+    int status;
+    {
+        FontDebug win;
+        status = app->run(win);
+    }
+
+    if (tracePath && *tracePath)
+    {
+        try
+        {
+            writeTrace(tracePath);
+            std::cerr << "Trace written to " << tracePath << "\n";
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Writing trace failed: " << e.what() << "\n";
+        }
+    }
+    return status;
 }
 
@@ -0,0 +1,697 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+// Renders every charmap entry of a font for each combination of size, load
+// flags and render mode, packing the bitmaps into PNG atlases described by a
+// JSON index. Meant for comparing FreeType builds, no GTK involved.
+
+#include "bitmap_convert.hpp"
+#include "font_file.hpp"
+#include "render.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <cairo.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Glyphs rendered and packed together, one atlas page each, fewer for
+// large sizes (see glyphsPerPage())
+const size_t kGlyphsPerPage = 256;
+// Atlases grow past this width only for wider glyphs
+const int kAtlasWidth = 1024;
+// A page that would grow taller continues in another atlas. Well below
+// cairo's 32767 pixel limit on image surfaces.
+const int kMaxAtlasHeight = 16384;
+// Gap around every glyph in an atlas
+const int kAtlasPadding = 1;
+
+struct NamedFlag
+{
+    const char *name;
+    FT_Int32 value;
+};
+
+// Same names as the load flag toggles in the GUI
+const NamedFlag kLoadFlags[] = {
+    { "DEFAULT",         FT_LOAD_DEFAULT },
+    { "COLOR",           FT_LOAD_COLOR },
+    { "NO_SCALE",        FT_LOAD_NO_SCALE },
+    { "NO_BITMAP",       FT_LOAD_NO_BITMAP },
+    { "NO_HINTING",      FT_LOAD_NO_HINTING },
+    { "NO_AUTOHINT",     FT_LOAD_NO_AUTOHINT },
+    { "LINEAR_DESIGN",   FT_LOAD_LINEAR_DESIGN },
+    { "FORCE_AUTOHINT",  FT_LOAD_FORCE_AUTOHINT },
+    { "VERTICAL_LAYOUT", FT_LOAD_VERTICAL_LAYOUT },
+    { "TARGET_LIGHT",    FT_LOAD_TARGET_LIGHT },
+    { "TARGET_MONO",     FT_LOAD_TARGET_MONO },
+    { "TARGET_LCD",      FT_LOAD_TARGET_LCD },
+    { "TARGET_LCD_V",    FT_LOAD_TARGET_LCD_V },
+};
+
+const NamedFlag kRenderModes[] = {
+    { "NORMAL", FT_RENDER_MODE_NORMAL },
+    { "LIGHT",  FT_RENDER_MODE_LIGHT },
+    { "MONO",   FT_RENDER_MODE_MONO },
+    { "LCD",    FT_RENDER_MODE_LCD },
+    { "LCD_V",  FT_RENDER_MODE_LCD_V },
+#if (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+    { "SDF",    FT_RENDER_MODE_SDF },
+#endif
+};
+
+struct Config
+{
+    std::string name;
+    int charSize;
+    std::string loadFlagsName;
+    FT_Int32 loadFlags;
+    std::string renderModeName;
+    FT_Render_Mode renderMode;
+};
+
+struct Options
+{
+    std::string fontPath;
+    FT_Long faceIndex = 0;
+    std::string outputDir;
+    std::vector<int> sizes = { 16 };
+    std::vector<std::string> loadFlags = { "DEFAULT" };
+    std::vector<std::string> renderModes = { "NORMAL" };
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+std::vector<std::string> splitList(const std::string &list, char separator)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, separator))
+    {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+FT_Int32 lookupFlag(const NamedFlag *begin, const NamedFlag *end, const std::string &name, const char *what)
+{
+    auto it = std::find_if(begin, end, [&](const NamedFlag &f) { return name == f.name; });
+    if (it == end) throw std::runtime_error(std::string("Unknown ") + what + ": " + name);
+    return it->value;
+}
+
+// "NO_HINTING+COLOR" -> FT_LOAD_NO_HINTING | FT_LOAD_COLOR
+FT_Int32 parseLoadFlags(const std::string &set)
+{
+    FT_Int32 flags = 0;
+    for (const std::string &name : splitList(set, '+'))
+    {
+        flags |= lookupFlag(std::begin(kLoadFlags), std::end(kLoadFlags), name, "load flag");
+    }
+    return flags;
+}
+
+std::vector<Config> makeConfigs(const Options &options)
+{
+    std::vector<Config> configs;
+    for (int size : options.sizes)
+    {
+        for (const std::string &flags : options.loadFlags)
+        {
+            for (const std::string &mode : options.renderModes)
+            {
+                Config config;
+                config.charSize = size;
+                config.loadFlagsName = flags;
+                config.loadFlags = parseLoadFlags(flags);
+                config.renderModeName = mode;
+                config.renderMode = (FT_Render_Mode)lookupFlag(std::begin(kRenderModes), std::end(kRenderModes), mode, "render mode");
+                config.name = std::to_string(size) + "-" + flags + "-" + mode;
+                std::replace(config.name.begin(), config.name.end(), '+', '_');
+                configs.push_back(std::move(config));
+            }
+        }
+    }
+    return configs;
+}
+
+std::string jsonString(const std::string &s)
+{
+    std::string out = "\"";
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if ((unsigned char)c < 0x20)
+            {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+// Per-thread queues of task ids. Owners take from the back of their own
+// queue and idle threads steal from the front of the others', so threads
+// that drew cheap glyphs (spaces, small sizes) help with expensive ones.
+class WorkStealingPool
+{
+public:
+    WorkStealingPool(unsigned threadCount, size_t taskCount)
+        : m_queues(threadCount)
+    {
+        // Contiguous runs keep a thread on one config, stealing splits them
+        for (size_t task = 0; task < taskCount; ++task)
+        {
+            m_queues[task * threadCount / taskCount].tasks.push_back(task);
+        }
+    }
+
+    // Calls `work(thread, task)` for every task
+    void run(const std::function<void(unsigned, size_t)> &work)
+    {
+        std::vector<std::thread> threads;
+        for (unsigned thread = 0; thread < m_queues.size(); ++thread)
+        {
+            threads.emplace_back([this, thread, &work]()
+            {
+                size_t task;
+                while (take(thread, task))
+                {
+                    work(thread, task);
+                }
+            });
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    bool take(unsigned thread, size_t &task)
+    {
+        {
+            Queue &own = m_queues[thread];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        // No tasks are added while running, so one empty pass means done
+        for (size_t i = 1; i < m_queues.size(); ++i)
+        {
+            Queue &victim = m_queues[(thread + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Queue> m_queues;
+};
+
+// FreeType objects are not shared between threads, every thread opens the
+// face itself over the shared file mapping
+struct ThreadFace
+{
+    FT_Library ft = nullptr;
+    FT_Face face = nullptr;
+    std::shared_ptr<const FaceInfo> info;
+
+    ~ThreadFace()
+    {
+        if (face) FT_Done_Face(face);
+        if (ft) FT_Done_FreeType(ft);
+    }
+
+    void open(const MappedFontFile &file, FT_Long faceIndex)
+    {
+        if (FT_Init_FreeType(&ft)) throw std::runtime_error("FT_Init_FreeType");
+        FT_Error errorCode = openMappedFace(ft, file, faceIndex, &face);
+        if (errorCode) throw FreetypeError(errorCode, "FT_Open_Face");
+        info = makeFaceInfo(face, file.path(), faceIndex);
+    }
+};
+
+struct PageTask
+{
+    size_t config;
+    size_t page;
+    size_t begin, end;
+};
+
+struct PageResult
+{
+    // Atlas files written, in the output directory
+    std::vector<std::string> files;
+    // Glyph objects of the JSON index, comma separated
+    std::string glyphsJson;
+    size_t rendered = 0;
+    size_t failed = 0;
+};
+
+// Glyphs per page so that a page of `config` usually fits one atlas.
+// Glyph boxes are guessed at 1.5 em, three times that across the subpixels
+// of LCD modes.
+size_t glyphsPerPage(const Config &config)
+{
+    int cellWidth = config.charSize * 3 / 2 + kAtlasPadding;
+    int cellHeight = cellWidth;
+    if (config.renderMode == FT_RENDER_MODE_LCD) cellWidth *= 3;
+    if (config.renderMode == FT_RENDER_MODE_LCD_V) cellHeight *= 3;
+
+    size_t perRow = std::max(1, kAtlasWidth / std::max(1, cellWidth));
+    size_t rows = std::max(1, kMaxAtlasHeight / std::max(1, cellHeight));
+    return std::clamp<size_t>(perRow * rows, 1, kGlyphsPerPage);
+}
+
+// Renders one page worth of glyphs and writes them as atlases named
+// `fileStem`.png, then `fileStem`-1.png and so on if they overflow
+PageResult renderPage(FT_Face face, const std::shared_ptr<const FaceInfo> &info, const Config &config,
+    const std::vector<CharMapEntry> &charMap, const PageTask &task, const fs::path &outputDir, const std::string &fileStem)
+{
+    PageResult result;
+
+    std::vector<RenderedGlyphPtr> glyphs;
+    for (size_t i = task.begin; i < task.end; ++i)
+    {
+        RenderRequest request;
+        request.fontPath = info->path;
+        request.faceIndex = info->face_index;
+        request.charCode = charMap[i].charCode;
+        request.charSize = config.charSize;
+        request.loadFlags = config.loadFlags;
+        request.renderMode = config.renderMode;
+
+        try
+        {
+            glyphs.push_back(renderGlyph(face, request, info));
+            ++result.rendered;
+        }
+        catch (const std::exception &e)
+        {
+            glyphs.push_back(nullptr);
+            ++result.failed;
+            std::cerr << "U+" << std::hex << request.charCode << std::dec << " (" << config.name << "): " << e.what() << "\n";
+        }
+    }
+
+    // Shelf packing, rows of glyphs in charmap order
+    int atlasWidth = kAtlasWidth;
+    for (const RenderedGlyphPtr &glyph : glyphs)
+    {
+        if (glyph) atlasWidth = std::max<int>(atlasWidth, glyph->bitmap.width + 2 * kAtlasPadding);
+    }
+
+    struct Placement { int atlas, x, y; };
+    std::vector<Placement> placements(glyphs.size());
+    std::vector<int> atlasHeights(1, kAtlasPadding);
+    int x = kAtlasPadding;
+    int y = kAtlasPadding;
+    int rowHeight = 0;
+    for (size_t i = 0; i < glyphs.size(); ++i)
+    {
+        if (!glyphs[i]) continue;
+        const FT_Bitmap &bitmap = glyphs[i]->bitmap;
+        if (x + (int)bitmap.width + kAtlasPadding > atlasWidth)
+        {
+            x = kAtlasPadding;
+            y += rowHeight + kAtlasPadding;
+            rowHeight = 0;
+        }
+        // Continue in a new atlas, unless this one is still empty
+        if (y + (int)bitmap.rows + kAtlasPadding > kMaxAtlasHeight && atlasHeights.back() > kAtlasPadding)
+        {
+            atlasHeights.push_back(kAtlasPadding);
+            x = kAtlasPadding;
+            y = kAtlasPadding;
+            rowHeight = 0;
+        }
+        placements[i] = { (int)atlasHeights.size() - 1, x, y };
+        x += bitmap.width + kAtlasPadding;
+        rowHeight = std::max<int>(rowHeight, bitmap.rows);
+        atlasHeights.back() = std::max(atlasHeights.back(), y + rowHeight + kAtlasPadding);
+    }
+
+    std::vector<cairo_surface_t*> surfaces;
+    auto destroySurfaces = [&]()
+    {
+        for (cairo_surface_t *surface : surfaces)
+        {
+            cairo_surface_destroy(surface);
+        }
+    };
+    for (size_t atlas = 0; atlas < atlasHeights.size(); ++atlas)
+    {
+        result.files.push_back(atlas == 0 ? fileStem + ".png" : fileStem + "-" + std::to_string(atlas) + ".png");
+
+        cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, atlasWidth, atlasHeights[atlas]);
+        surfaces.push_back(surface);
+        cairo_status_t status = cairo_surface_status(surface);
+        if (status != CAIRO_STATUS_SUCCESS)
+        {
+            destroySurfaces();
+            throw std::runtime_error(result.files.back() + ": " + std::to_string(atlasWidth) + "x" +
+                std::to_string(atlasHeights[atlas]) + " atlas: " + cairo_status_to_string(status));
+        }
+
+        cairo_surface_flush(surface);
+        memset(cairo_image_surface_get_data(surface), 0, (size_t)cairo_image_surface_get_stride(surface) * atlasHeights[atlas]);
+    }
+
+    std::ostringstream json;
+    for (size_t i = 0; i < glyphs.size(); ++i)
+    {
+        if (i > 0) json << ",\n";
+        json << "        { \"charCode\": " << charMap[task.begin + i].charCode;
+
+        const RenderedGlyphPtr &glyph = glyphs[i];
+        if (!glyph)
+        {
+            json << ", \"error\": true }";
+            continue;
+        }
+
+        const FT_Bitmap &bitmap = glyph->bitmap;
+        const Placement &placement = placements[i];
+        if (bitmap.width > 0 && bitmap.rows > 0 && bitmapConvertSupported(bitmap))
+        {
+            cairo_surface_t *surface = surfaces[placement.atlas];
+            int stride = cairo_image_surface_get_stride(surface);
+            unsigned char *row = cairo_image_surface_get_data(surface) + (size_t)placement.y * stride;
+            convertBitmap(bitmap, false, reinterpret_cast<uint32_t*>(row) + placement.x, stride);
+        }
+
+        json << ", \"glyphIndex\": " << glyph->glyph_index
+             << ", \"page\": " << task.page
+             << ", \"atlas\": " << jsonString(result.files[placement.atlas])
+             << ", \"x\": " << placement.x << ", \"y\": " << placement.y
+             << ", \"width\": " << bitmap.width << ", \"height\": " << bitmap.rows
+             << ", \"pixelMode\": " << (int)bitmap.pixel_mode
+             << ", \"left\": " << glyph->bitmap_left << ", \"top\": " << glyph->bitmap_top
+             << ", \"advanceX\": " << glyph->advance.x << ", \"advanceY\": " << glyph->advance.y
+             << " }";
+    }
+    result.glyphsJson = json.str();
+
+    for (size_t atlas = 0; atlas < surfaces.size(); ++atlas)
+    {
+        cairo_surface_mark_dirty(surfaces[atlas]);
+        std::string pngPath = (outputDir / result.files[atlas]).string();
+        cairo_status_t status = cairo_surface_write_to_png(surfaces[atlas], pngPath.c_str());
+        if (status != CAIRO_STATUS_SUCCESS)
+        {
+            destroySurfaces();
+            throw std::runtime_error(pngPath + ": " + cairo_status_to_string(status));
+        }
+    }
+    destroySurfaces();
+
+    return result;
+}
+
+void usage(const char *argv0)
+{
+    std::cerr << "Usage: " << argv0 << " [options] FONT OUTPUT_DIR\n"
+              << "\n"
+              << "Renders every charmap entry of FONT into PNG atlases and an index.json in OUTPUT_DIR.\n"
+              << "\n"
+              << "  --face-index N        face of a collection to render (0)\n"
+              << "  --sizes 12,16,...     char sizes in pixels (16)\n"
+              << "  --load-flags SETS     comma separated sets of '+' joined load flags,\n"
+              << "                        e.g. DEFAULT,NO_HINTING,FORCE_AUTOHINT+COLOR (DEFAULT)\n"
+              << "  --render-modes MODES  e.g. NORMAL,LIGHT,MONO,LCD,LCD_V (NORMAL)\n"
+              << "  --threads N           worker threads (all cores)\n";
+}
+
+Options parseOptions(int argc, char **argv)
+{
+    Options options;
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0)
+        {
+            positional.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+        std::string value = argv[++i];
+
+        if (arg == "--face-index")
+        {
+            options.faceIndex = std::stol(value);
+        }
+        else if (arg == "--sizes")
+        {
+            options.sizes.clear();
+            for (const std::string &size : splitList(value, ','))
+            {
+                options.sizes.push_back(std::stoi(size));
+            }
+        }
+        else if (arg == "--load-flags")
+        {
+            options.loadFlags = splitList(value, ',');
+        }
+        else if (arg == "--render-modes")
+        {
+            options.renderModes = splitList(value, ',');
+        }
+        else if (arg == "--threads")
+        {
+            options.threads = std::max(1, std::stoi(value));
+        }
+        else
+        {
+            throw std::runtime_error("Unknown option " + arg);
+        }
+    }
+
+    if (positional.size() != 2) throw std::runtime_error("Expected FONT and OUTPUT_DIR");
+    options.fontPath = positional[0];
+    options.outputDir = positional[1];
+    return options;
+}
+
+int run(const Options &options)
+{
+    std::vector<Config> configs = makeConfigs(options);
+    if (configs.empty()) throw std::runtime_error("Nothing to render");
+
+    std::shared_ptr<const MappedFontFile> file = mapFontFile(options.fontPath);
+
+    std::vector<CharMapEntry> charMap;
+    std::string freetypeVersion;
+    {
+        ThreadFace face;
+        face.open(*file, options.faceIndex);
+
+        FT_UInt glyphIndex;
+        FT_ULong charCode = FT_Get_First_Char(face.face, &glyphIndex);
+        while (glyphIndex != 0)
+        {
+            charMap.push_back({ charCode, glyphIndex });
+            charCode = FT_Get_Next_Char(face.face, charCode, &glyphIndex);
+        }
+
+        FT_Int major, minor, patch;
+        FT_Library_Version(face.ft, &major, &minor, &patch);
+        freetypeVersion = std::to_string(major) + "." + std::to_string(minor) + "." + std::to_string(patch);
+    }
+
+    std::vector<PageTask> tasks;
+    for (size_t config = 0; config < configs.size(); ++config)
+    {
+        size_t perPage = glyphsPerPage(configs[config]);
+        for (size_t begin = 0; begin < charMap.size(); begin += perPage)
+        {
+            tasks.push_back({ config, begin / perPage, begin, std::min(charMap.size(), begin + perPage) });
+        }
+    }
+
+    fs::create_directories(options.outputDir);
+    auto pageFileStem = [&](const PageTask &task)
+    {
+        return configs[task.config].name + "-" + std::to_string(task.page);
+    };
+
+    unsigned threadCount = std::min<size_t>(options.threads, std::max<size_t>(1, tasks.size()));
+    std::vector<ThreadFace> faces(threadCount);
+    std::vector<PageResult> results(tasks.size());
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    std::atomic<bool> failed { false };
+
+    auto start = std::chrono::steady_clock::now();
+
+    WorkStealingPool pool(threadCount, tasks.size());
+    pool.run([&](unsigned thread, size_t index)
+    {
+        if (failed) return;
+        try
+        {
+            ThreadFace &face = faces[thread];
+            if (!face.face) face.open(*file, options.faceIndex);
+
+            const PageTask &task = tasks[index];
+            results[index] = renderPage(face.face, face.info, configs[task.config], charMap, task,
+                options.outputDir, pageFileStem(task));
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+            failed = true;
+        }
+    });
+    if (error) std::rethrow_exception(error);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t rendered = 0;
+    size_t failedGlyphs = 0;
+    for (const PageResult &result : results)
+    {
+        rendered += result.rendered;
+        failedGlyphs += result.failed;
+    }
+
+    std::ofstream index(fs::path(options.outputDir) / "index.json");
+    index << "{\n"
+          << "  \"font\": " << jsonString(options.fontPath) << ",\n"
+          << "  \"faceIndex\": " << options.faceIndex << ",\n"
+          << "  \"freetype\": " << jsonString(freetypeVersion) << ",\n"
+          << "  \"threads\": " << threadCount << ",\n"
+          << "  \"glyphsRendered\": " << rendered << ",\n"
+          << "  \"glyphsFailed\": " << failedGlyphs << ",\n"
+          << "  \"seconds\": " << seconds << ",\n"
+          << "  \"glyphsPerSecond\": " << rendered / seconds << ",\n"
+          << "  \"configs\": [\n";
+
+    size_t taskIndex = 0;
+    for (size_t config = 0; config < configs.size(); ++config)
+    {
+        const Config &c = configs[config];
+        index << "    {\n"
+              << "      \"name\": " << jsonString(c.name) << ",\n"
+              << "      \"charSize\": " << c.charSize << ",\n"
+              << "      \"loadFlags\": " << jsonString(c.loadFlagsName) << ",\n"
+              << "      \"renderMode\": " << jsonString(c.renderModeName) << ",\n";
+
+        size_t firstTask = taskIndex;
+        while (taskIndex < tasks.size() && tasks[taskIndex].config == config) ++taskIndex;
+
+        index << "      \"pages\": [";
+        bool firstFile = true;
+        for (size_t t = firstTask; t < taskIndex; ++t)
+        {
+            for (const std::string &file : results[t].files)
+            {
+                index << (firstFile ? "" : ", ") << jsonString(file);
+                firstFile = false;
+            }
+        }
+        index << "],\n"
+              << "      \"glyphs\": [\n";
+        for (size_t t = firstTask; t < taskIndex; ++t)
+        {
+            index << results[t].glyphsJson << (t + 1 < taskIndex ? ",\n" : "\n");
+        }
+        index << "      ]\n"
+              << "    }" << (config + 1 < configs.size() ? "," : "") << "\n";
+    }
+    index << "  ]\n"
+          << "}\n";
+
+    if (!index) throw std::runtime_error("Failed writing index.json");
+
+    std::cout << "Rendered " << rendered << " glyphs (" << failedGlyphs << " failed) in "
+              << seconds << " s on " << threadCount << " threads, "
+              << (size_t)(rendered / seconds) << " glyphs/sec\n";
+    return failedGlyphs ? 1 : 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    try
+    {
+        options = parseOptions(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << "\n\n";
+        usage(argv[0]);
+        return 2;
+    }
+
+    try
+    {
+        return run(options);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
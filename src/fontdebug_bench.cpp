@@ -0,0 +1,381 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+// Costs of loading, rendering and drawing glyphs, to compare FreeType
+// versions and changes to FontDebug run to run. Results are printed as JSON
+// unless another --benchmark_format is given.
+//
+// The font is FONTDEBUG_BENCH_FONT, or DejaVuSans.ttf (else the first font)
+// from the font index.
+
+#include "bitmap_convert.hpp"
+#include "font_file.hpp"
+#include "font_index.hpp"
+#include "glyph_list.hpp"
+#include "glyph_painter.hpp"
+#include "render.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <freetype/ftglyph.h>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// Glyphs cycled through by the per-glyph benchmarks
+const size_t kSampleGlyphs = 256;
+
+const FT_Render_Mode kRenderModes[] = {
+    FT_RENDER_MODE_NORMAL,
+    FT_RENDER_MODE_LIGHT,
+    FT_RENDER_MODE_MONO,
+    FT_RENDER_MODE_LCD,
+    FT_RENDER_MODE_LCD_V,
+};
+const char *kRenderModeNames[] = { "NORMAL", "LIGHT", "MONO", "LCD", "LCD_V" };
+
+const FT_Int32 kLoadFlags[] = {
+    FT_LOAD_DEFAULT,
+    FT_LOAD_NO_HINTING,
+    FT_LOAD_FORCE_AUTOHINT,
+    FT_LOAD_COLOR,
+};
+const char *kLoadFlagNames[] = { "DEFAULT", "NO_HINTING", "FORCE_AUTOHINT", "COLOR" };
+
+std::string benchFontPath()
+{
+    if (const char *env = getenv("FONTDEBUG_BENCH_FONT")) return env;
+
+    FontIndex index = loadFontIndex(fontIndexCachePath());
+    if (index.empty())
+    {
+        std::atomic<bool> cancel { false };
+        index = scanFonts(fontDirs(), fontIndexCachePath(), cancel);
+    }
+
+    for (const FontIndexEntry &font : index)
+    {
+        if (font.faceCount > 0 && font.path.size() >= 14 && font.path.compare(font.path.size() - 14, 14, "/DejaVuSans.ttf") == 0)
+        {
+            return font.path;
+        }
+    }
+    for (const FontIndexEntry &font : index)
+    {
+        if (font.faceCount > 0) return font.path;
+    }
+    throw std::runtime_error("No font found, set FONTDEBUG_BENCH_FONT");
+}
+
+// One face shared by every benchmark, they run on the main thread
+struct BenchFace
+{
+    FT_Library ft = nullptr;
+    FT_Face face = nullptr;
+    std::shared_ptr<const MappedFontFile> file;
+    std::shared_ptr<const FaceInfo> info;
+    std::vector<CharMapEntry> charMap;
+    // Evenly spread over the charmap
+    std::vector<FT_ULong> sample;
+
+    BenchFace()
+    {
+        if (FT_Init_FreeType(&ft)) throw std::runtime_error("FT_Init_FreeType");
+
+        file = mapFontFile(benchFontPath());
+        FT_Error errorCode = openMappedFace(ft, *file, 0, &face);
+        if (errorCode) throw FreetypeError(errorCode, "FT_Open_Face");
+        info = makeFaceInfo(face, file->path(), 0);
+
+        FT_UInt glyphIndex;
+        FT_ULong charCode = FT_Get_First_Char(face, &glyphIndex);
+        while (glyphIndex != 0)
+        {
+            charMap.push_back({ charCode, glyphIndex });
+            charCode = FT_Get_Next_Char(face, charCode, &glyphIndex);
+        }
+        if (charMap.empty()) throw std::runtime_error(file->path() + " has no charmap entries");
+
+        size_t step = std::max<size_t>(1, charMap.size() / kSampleGlyphs);
+        for (size_t i = 0; i < charMap.size() && sample.size() < kSampleGlyphs; i += step)
+        {
+            sample.push_back(charMap[i].charCode);
+        }
+    }
+
+    ~BenchFace()
+    {
+        FT_Done_Face(face);
+        FT_Done_FreeType(ft);
+    }
+
+    void setSize(int charSize)
+    {
+        if (face->num_fixed_sizes)
+        {
+            FT_Select_Size(face, 0);
+        }
+        else
+        {
+            FT_Set_Char_Size(face, charSize * 64, charSize * 64, 0, 0);
+        }
+        FT_Set_Transform(face, nullptr, nullptr);
+    }
+};
+
+BenchFace& benchFace()
+{
+    static BenchFace face;
+    return face;
+}
+
+// FT_Load_Char + FT_Render_Glyph, as renderGlyph() does before copying the slot.
+// Args: render mode, load flags, char size.
+void BM_LoadRender(benchmark::State &state)
+{
+    BenchFace &bf = benchFace();
+    FT_Render_Mode renderMode = kRenderModes[state.range(0)];
+    FT_Int32 loadFlags = kLoadFlags[state.range(1)];
+    bf.setSize(state.range(2));
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        FT_ULong charCode = bf.sample[i++ % bf.sample.size()];
+        if (FT_Load_Char(bf.face, charCode, loadFlags) == 0)
+        {
+            FT_Render_Glyph(bf.face->glyph, renderMode);
+        }
+        benchmark::DoNotOptimize(bf.face->glyph->bitmap.buffer);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(std::string(kRenderModeNames[state.range(0)]) + "/" + kLoadFlagNames[state.range(1)]);
+}
+BENCHMARK(BM_LoadRender)->ArgsProduct({
+    benchmark::CreateDenseRange(0, std::size(kRenderModes) - 1, 1),
+    benchmark::CreateDenseRange(0, std::size(kLoadFlags) - 1, 1),
+    { 16, 64 },
+});
+
+// decomposeOutline() of hinted outlines at 64 px
+void BM_DecomposeOutline(benchmark::State &state)
+{
+    BenchFace &bf = benchFace();
+    bf.setSize(64);
+
+    std::vector<FT_Glyph> outlines;
+    for (FT_ULong charCode : bf.sample)
+    {
+        FT_Glyph glyph;
+        if (FT_Load_Char(bf.face, charCode, FT_LOAD_DEFAULT) == 0 &&
+            bf.face->glyph->format == FT_GLYPH_FORMAT_OUTLINE &&
+            FT_Get_Glyph(bf.face->glyph, &glyph) == 0)
+        {
+            outlines.push_back(glyph);
+        }
+    }
+    if (outlines.empty())
+    {
+        state.SkipWithError("Font has no outline glyphs");
+        return;
+    }
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        const FT_Outline &outline = reinterpret_cast<FT_OutlineGlyph>(outlines[i++ % outlines.size()])->outline;
+        benchmark::DoNotOptimize(decomposeOutline(outline));
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    for (FT_Glyph glyph : outlines)
+    {
+        FT_Done_Glyph(glyph);
+    }
+}
+BENCHMARK(BM_DecomposeOutline);
+
+// makeGlyphList() over the whole charmap, as shown by the glyph panel
+void BM_GlyphList(benchmark::State &state)
+{
+    BenchFace &bf = benchFace();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(makeGlyphList(bf.charMap));
+    }
+    state.SetItemsProcessed(state.iterations() * bf.charMap.size());
+    state.counters["glyphs"] = bf.charMap.size();
+}
+BENCHMARK(BM_GlyphList)->Unit(benchmark::kMillisecond);
+
+const BitmapConvertImpl kConvertImpls[] = {
+    BitmapConvertImpl::Scalar,
+    BitmapConvertImpl::SSE2,
+    BitmapConvertImpl::AVX2,
+};
+
+// Bitmaps convertBitmap() sees, sized like a 64 px glyph. BGRA is the size of
+// a Noto Color Emoji strike.
+struct ConvertCase
+{
+    const char *name;
+    unsigned char pixelMode;
+    int width;
+    int rows;
+    bool grayscaleLCD;
+};
+const ConvertCase kConvertCases[] = {
+    { "MONO",          FT_PIXEL_MODE_MONO,  64,  64,  false },
+    { "GRAY",          FT_PIXEL_MODE_GRAY,  64,  64,  false },
+    { "LCD",           FT_PIXEL_MODE_LCD,   192, 64,  false },
+    { "LCD grayscale", FT_PIXEL_MODE_LCD,   192, 64,  true },
+    { "LCD_V",         FT_PIXEL_MODE_LCD_V, 64,  192, false },
+    { "BGRA emoji",    FT_PIXEL_MODE_BGRA,  136, 128, false },
+};
+
+// convertBitmap() of random bitmaps, the drawer's cost of turning a glyph into an image.
+// Args: implementation, bitmap case.
+void BM_ConvertBitmap(benchmark::State &state)
+{
+    BitmapConvertImpl impl = kConvertImpls[state.range(0)];
+    const ConvertCase &c = kConvertCases[state.range(1)];
+    state.SetLabel(std::string(bitmapConvertImplName(impl)) + "/" + c.name);
+    if (!bitmapConvertImplSupported(impl))
+    {
+        state.SkipWithError("Not supported by this CPU");
+        return;
+    }
+
+    int pitch = c.width;
+    if (c.pixelMode == FT_PIXEL_MODE_MONO) pitch = (c.width + 7) / 8;
+    if (c.pixelMode == FT_PIXEL_MODE_BGRA) pitch = c.width * 4;
+
+    std::vector<uint8_t> pixels((size_t)pitch * c.rows);
+    std::mt19937 rng(1);
+    for (uint8_t &b : pixels)
+    {
+        b = rng();
+    }
+
+    FT_Bitmap bitmap = {};
+    bitmap.width = c.width;
+    bitmap.rows = c.rows;
+    bitmap.pitch = pitch;
+    bitmap.buffer = pixels.data();
+    bitmap.pixel_mode = c.pixelMode;
+    bitmap.num_grays = c.pixelMode == FT_PIXEL_MODE_MONO ? 2 : 256;
+
+    std::vector<uint32_t> out((size_t)c.width * c.rows);
+    for (auto _ : state)
+    {
+        convertBitmap(bitmap, c.grayscaleLCD, out.data(), c.width * sizeof(uint32_t), impl);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * out.size() * sizeof(uint32_t));
+}
+BENCHMARK(BM_ConvertBitmap)->ArgsProduct({
+    benchmark::CreateDenseRange(0, std::size(kConvertImpls) - 1, 1),
+    benchmark::CreateDenseRange(0, std::size(kConvertCases) - 1, 1),
+});
+
+// What the drawer paints into a tile, for a whole 800x600 view of one glyph.
+// Args: zoom relative to fitting the glyph into the view, grid and outline on/off.
+void BM_DrawScene(benchmark::State &state)
+{
+    BenchFace &bf = benchFace();
+    const int width = 800;
+    const int height = 600;
+
+    RenderRequest request;
+    request.charCode = 'g';
+    request.charSize = 64;
+    request.renderMode = FT_RENDER_MODE_LCD;
+    if (!FT_Get_Char_Index(bf.face, request.charCode)) request.charCode = bf.sample[bf.sample.size() / 2];
+    RenderedGlyphPtr glyph = renderGlyph(bf.face, request, bf.info);
+
+    GlyphPainter painter;
+    if (!painter.setGlyph(glyph))
+    {
+        state.SkipWithError("Unsupported pixel mode");
+        return;
+    }
+
+    PaintOptions options;
+    options.grid = state.range(1);
+    options.outline = state.range(1);
+    options.baseline = state.range(1);
+
+    // Same initial fit as the drawer, zoomed around the glyph's center
+    const BitmapGeometry &geometry = painter.geometry();
+    double scale = std::min(width * 0.75 / std::max(1, geometry.width), height * 0.75 / std::max(1, geometry.height));
+    Cairo::Matrix viewMatrix = Cairo::identity_matrix();
+    viewMatrix.scale(scale * state.range(0), scale * state.range(0));
+    viewMatrix.translate(-glyph->bitmap_left - geometry.width / 2.0, glyph->bitmap_top - geometry.height / 2.0);
+    viewMatrix = viewMatrix * Cairo::translation_matrix(width * 0.5, height * 0.5);
+
+    auto surface = Cairo::ImageSurface::create(Cairo::FORMAT_RGB24, width, height);
+    PixelRect visible = painter.visiblePixels(viewMatrix, width, height);
+
+    for (auto _ : state)
+    {
+        auto cr = Cairo::Context::create(surface);
+        cr->transform(viewMatrix);
+        painter.drawScene(cr, visible, options);
+        surface->flush();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DrawScene)->ArgsProduct({ { 1, 8, 32 }, { 0, 1 } })->Unit(benchmark::kMicrosecond);
+
+}
+
+int main(int argc, char** argv)
+{
+    // JSON by default, a later --benchmark_format on the command line wins
+    std::vector<char*> args(argv, argv + argc);
+    std::string jsonFormat = "--benchmark_format=json";
+    args.insert(args.begin() + 1, jsonFormat.data());
+    int count = args.size();
+
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) return 1;
+
+    try
+    {
+        benchFace();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,220 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "glyph_cache.hpp"
+#include "font_file.hpp"
+#include "trace.hpp"
+
+#include <cstdlib>
+
+#include <freetype/ftglyph.h>
+
+// Faces FTC keeps open, also the number of face ids remembered
+static const FT_UInt kMaxFaces = 4;
+static const FT_UInt kMaxSizes = 16;
+
+// Bitmaps of larger sizes rarely fit an sbit (255 pixels, 127 byte rows) and
+// FTC reloads glyphs that did not fit on every lookup, so those go straight
+// to the image cache
+static const int kMaxSBitCharSize = 24;
+
+size_t defaultGlyphCacheBudget()
+{
+    size_t megabytes = 32;
+    if (const char *env = getenv("FONTDEBUG_GLYPH_CACHE_MB"))
+    {
+        megabytes = strtoull(env, nullptr, 10);
+    }
+    return megabytes << 20;
+}
+
+GlyphCache::GlyphCache(FT_Library ft, size_t budget)
+{
+    m_stats.budget = budget;
+
+    FT_Error errorCode = FTC_Manager_New(ft, kMaxFaces, kMaxSizes, budget, &GlyphCache::requestFace, nullptr, &m_manager);
+    if (errorCode) throw FreetypeError(errorCode, "FTC_Manager_New");
+
+    errorCode = FTC_SBitCache_New(m_manager, &m_sbitCache);
+    if (!errorCode) errorCode = FTC_ImageCache_New(m_manager, &m_imageCache);
+    if (errorCode)
+    {
+        FTC_Manager_Done(m_manager);
+        throw FreetypeError(errorCode, "FTC_SBitCache_New");
+    }
+}
+
+GlyphCache::~GlyphCache()
+{
+    // Also frees the caches and closes the faces
+    FTC_Manager_Done(m_manager);
+}
+
+FT_Error GlyphCache::requestFace(FTC_FaceID faceId, FT_Library ft, FT_Pointer, FT_Face *face)
+{
+    const FaceId *id = static_cast<const FaceId*>(faceId);
+    return openMappedFace(ft, *id->file, id->info->face_index, face);
+}
+
+FTC_FaceID GlyphCache::faceId(const std::shared_ptr<const FaceInfo> &faceInfo)
+{
+    for (auto it = m_faceIds.begin(); it != m_faceIds.end(); ++it)
+    {
+        if (it->info == faceInfo)
+        {
+            m_faceIds.splice(m_faceIds.begin(), m_faceIds, it);
+            return &*it;
+        }
+    }
+
+    // A FaceInfo stands for one version of the file, the same as the face cache
+    m_faceIds.push_front({ faceInfo, mapFontFile(faceInfo->path) });
+    while (m_faceIds.size() > kMaxFaces)
+    {
+        FTC_Manager_RemoveFaceID(m_manager, &m_faceIds.back());
+        m_faceIds.pop_back();
+    }
+    return &m_faceIds.front();
+}
+
+RenderedGlyphPtr GlyphCache::render(const RenderRequest &request, const std::shared_ptr<const FaceInfo> &faceInfo,
+                                    RenderTimings *timings)
+{
+    bool identity = request.matrix.xx == 0x10000 && request.matrix.xy == 0 &&
+                    request.matrix.yx == 0 && request.matrix.yy == 0x10000 &&
+                    request.delta.x == 0 && request.delta.y == 0;
+    // FTC renders in the mode of the load target, renderGlyph() in the
+    // requested one, unless the load itself renders
+    bool sameMode = (request.loadFlags & FT_LOAD_RENDER) ||
+                    (FT_Render_Mode)FT_LOAD_TARGET_MODE(request.loadFlags) == request.renderMode;
+    if (!identity || !sameMode || faceInfo->num_fixed_sizes)
+    {
+        ++m_stats.uncached;
+        return nullptr;
+    }
+
+    std::chrono::steady_clock::time_point lap;
+    if (timings) lap = std::chrono::steady_clock::now();
+
+    FTC_ScalerRec scaler = {};
+    scaler.face_id = faceId(faceInfo);
+    scaler.width = request.charSize * 64;
+    scaler.height = request.charSize * 64;
+    scaler.pixel = 0;
+
+    FT_Size size;
+    FT_Error errorCode;
+    {
+        TRACE_SCOPE("freetype", "FTC_Manager_LookupSize");
+        errorCode = FTC_Manager_LookupSize(m_manager, &scaler, &size);
+    }
+    if (errorCode) throw FreetypeError(errorCode, "FTC_Manager_LookupSize");
+
+    FT_Face face = size->face;
+    FT_Set_Transform(face, nullptr, nullptr);
+    if (timings) addLapTime(lap, timings->setCharSize);
+
+    // Loading without rendering gives the metrics and outline the cached
+    // bitmaps lack, so every request still pays for the load and hinting.
+    // Rasterizing is what the caches save.
+    FT_UInt glyphIndex = FT_Get_Char_Index(face, request.charCode);
+    {
+        TRACE_SCOPE("freetype", "FT_Load_Glyph");
+        errorCode = FT_Load_Glyph(face, glyphIndex, request.loadFlags & ~FT_LOAD_RENDER);
+    }
+    if (errorCode) throw FreetypeError(errorCode, "FT_Load_Glyph");
+    if (timings) addLapTime(lap, timings->loadChar);
+
+    std::shared_ptr<RenderedGlyph> res;
+    {
+        TRACE_SCOPE("render", "copyGlyphSlot");
+        res = copyGlyphSlot(face->glyph, request, faceInfo);
+    }
+    if (timings) addLapTime(lap, timings->copy);
+
+    // FTC keeps no counters, so hits and misses are an estimate. A miss
+    // shows as FTC loading the glyph again into the slot, this time
+    // rendered, so the slot stops looking like the unrendered load above.
+    // Only read, the slot belongs to FreeType.
+    const FT_Glyph_Format loadedFormat = face->glyph->format;
+    const unsigned char *loadedBuffer = face->glyph->bitmap.buffer;
+
+    FT_Int32 flags = request.loadFlags | FT_LOAD_RENDER;
+    FTC_SBit sbit = nullptr;
+    if (request.charSize <= kMaxSBitCharSize)
+    {
+        {
+            TRACE_SCOPE("freetype", "FTC_SBitCache_LookupScaler");
+            errorCode = FTC_SBitCache_LookupScaler(m_sbitCache, &scaler, flags, glyphIndex, &sbit, nullptr);
+        }
+        if (errorCode)
+        {
+            ++m_stats.uncached;
+            return nullptr;
+        }
+
+        // Glyphs that did not fit come back without a buffer and width 255
+        if (!sbit->buffer && sbit->width == 255) sbit = nullptr;
+    }
+
+    if (sbit)
+    {
+        FT_Bitmap bitmap = {};
+        bitmap.rows = sbit->height;
+        bitmap.width = sbit->width;
+        bitmap.pitch = sbit->pitch;
+        bitmap.buffer = sbit->buffer;
+        bitmap.num_grays = sbit->max_grays + 1;
+        bitmap.pixel_mode = sbit->format;
+
+        res->setBitmap(bitmap);
+        res->bitmap_left = sbit->left;
+        res->bitmap_top = sbit->top;
+    }
+    else
+    {
+        FT_Glyph glyph;
+        {
+            TRACE_SCOPE("freetype", "FTC_ImageCache_LookupScaler");
+            errorCode = FTC_ImageCache_LookupScaler(m_imageCache, &scaler, flags, glyphIndex, &glyph, nullptr);
+        }
+        // Leave failures to renderGlyph(), it reports them
+        if (errorCode || glyph->format != FT_GLYPH_FORMAT_BITMAP)
+        {
+            ++m_stats.uncached;
+            return nullptr;
+        }
+
+        FT_BitmapGlyph bitmapGlyph = reinterpret_cast<FT_BitmapGlyph>(glyph);
+        res->setBitmap(bitmapGlyph->bitmap);
+        res->bitmap_left = bitmapGlyph->left;
+        res->bitmap_top = bitmapGlyph->top;
+    }
+    res->format = FT_GLYPH_FORMAT_BITMAP;
+    if (timings) addLapTime(lap, timings->renderGlyph);
+
+    bool loadedAgain = face->glyph->format != loadedFormat || face->glyph->bitmap.buffer != loadedBuffer;
+    if (loadedAgain)
+    {
+        ++m_stats.misses;
+    }
+    else
+    {
+        ++m_stats.hits;
+    }
+    return res;
+}
@@ -0,0 +1,86 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "render.hpp"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+
+#include <freetype/freetype.h>
+#include <freetype/ftcache.h>
+
+class MappedFontFile;
+
+struct GlyphCacheStats
+{
+    // Estimated from the glyph slot, FTC keeps no counters
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // Requests FTC can't serve exactly or failed to serve, rendered directly
+    // on the face
+    uint64_t uncached = 0;
+    size_t budget = 0;
+};
+
+// Memory budget from FONTDEBUG_GLYPH_CACHE_MB, 32 MiB by default
+size_t defaultGlyphCacheBudget();
+
+// Renders glyphs through FreeType's cache subsystem. FTC_Manager keeps the
+// sized faces, so going back to a char size skips FT_Set_Char_Size, and the
+// sbit and image caches keep the rasterized bitmaps of every (size, load
+// flags, glyph) already seen.
+//
+// Only untransformed requests on scalable faces whose render mode is implied
+// by the load flags are served, since those are the ones FTC reproduces
+// exactly. Not thread safe.
+class GlyphCache
+{
+public:
+    GlyphCache(FT_Library ft, size_t budget);
+    ~GlyphCache();
+
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    // Same result as renderGlyph(), nullptr if the request must be rendered
+    // on the face directly. Stages are timed into `timings` unless it is null.
+    RenderedGlyphPtr render(const RenderRequest &request, const std::shared_ptr<const FaceInfo> &faceInfo,
+                            RenderTimings *timings = nullptr);
+
+    const GlyphCacheStats& stats() const { return m_stats; }
+
+private:
+    // Addresses are the FTC face ids, FTC opens the faces on demand
+    struct FaceId
+    {
+        std::shared_ptr<const FaceInfo> info;
+        std::shared_ptr<const MappedFontFile> file;
+    };
+
+    static FT_Error requestFace(FTC_FaceID faceId, FT_Library ft, FT_Pointer, FT_Face *face);
+    FTC_FaceID faceId(const std::shared_ptr<const FaceInfo> &faceInfo);
+
+    FTC_Manager m_manager = nullptr;
+    FTC_SBitCache m_sbitCache = nullptr;
+    FTC_ImageCache m_imageCache = nullptr;
+    // Most recently used first
+    std::list<FaceId> m_faceIds;
+    GlyphCacheStats m_stats;
+};
@@ -0,0 +1,139 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "glyph_list.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <unicode/uchar.h>
+#include <unicode/uversion.h>
+#if U_ICU_VERSION_MAJOR_NUM >= 63
+#include <unicode/ucpmap.h>
+#endif
+
+void appendGlyphs(GlyphList &list, const std::vector<CharMapEntry> &charMap)
+{
+    list.entries.reserve(list.entries.size() + charMap.size());
+    list.index.reserve(list.entries.size() + charMap.size());
+
+    // The charmap is sorted, so blocks are found by merging with the range table
+    const std::vector<UnicodeBlockRange> &ranges = unicodeBlockRanges();
+    size_t range = list.blockRange;
+
+    for (const CharMapEntry &entry : charMap)
+    {
+        while (range + 1 < ranges.size() && (UChar32)entry.charCode > ranges[range].last)
+        {
+            ++range;
+        }
+
+        // Like ublock_getCode(), charcodes past the Unicode range have no block
+        int32_t block = UBLOCK_NO_BLOCK;
+        if (entry.charCode <= UCHAR_MAX_VALUE)
+        {
+            block = ranges[range].block;
+        }
+        uint32_t index = list.entries.size();
+
+        if (list.groups.empty() || list.groups.back().block != block)
+        {
+            list.groups.push_back({ block, index, index });
+        }
+
+        uint32_t group = list.groups.size() - 1;
+        list.entries.push_back({ (uint32_t)entry.charCode, entry.glyphIndex, block, group });
+        list.groups.back().end = index + 1;
+        list.index.emplace(entry.charCode, index);
+    }
+
+    list.blockRange = range;
+}
+
+GlyphList makeGlyphList(const std::vector<CharMapEntry> &charMap)
+{
+    GlyphList list;
+    appendGlyphs(list, charMap);
+    return list;
+}
+
+const GlyphListEntry* GlyphList::find(uint32_t charCode) const
+{
+    auto it = index.find(charCode);
+    if (it == index.end()) return nullptr;
+    return &entries[it->second];
+}
+
+const std::vector<UnicodeBlockRange>& unicodeBlockRanges()
+{
+    static const std::vector<UnicodeBlockRange> ranges = []()
+    {
+        std::vector<UnicodeBlockRange> ranges;
+        UErrorCode errorCode = U_ZERO_ERROR;
+
+#if U_ICU_VERSION_MAJOR_NUM >= 63
+        const UCPMap *map = u_getIntPropertyMap(UCHAR_BLOCK, &errorCode);
+        if (U_FAILURE(errorCode)) throw std::runtime_error("u_getIntPropertyMap");
+
+        UChar32 start = 0;
+        uint32_t value;
+        UChar32 end;
+        while ((end = ucpmap_getRange(map, start, UCPMAP_RANGE_NORMAL, 0, nullptr, nullptr, &value)) >= 0)
+        {
+            ranges.push_back({ start, end, (int32_t)value });
+            start = end + 1;
+        }
+#else
+        for (UChar32 c = 0; c <= UCHAR_MAX_VALUE; ++c)
+        {
+            int32_t block = u_getIntPropertyValue(c, UCHAR_BLOCK);
+            if (ranges.empty() || ranges.back().block != block)
+            {
+                ranges.push_back({ c, c, block });
+            }
+            ranges.back().last = c;
+        }
+#endif
+
+        return ranges;
+    }();
+
+    return ranges;
+}
+
+const char* unicodeBlockName(int blockCode)
+{
+    static const std::vector<std::string> names = []()
+    {
+        std::vector<std::string> names(u_getIntPropertyMaxValue(UCHAR_BLOCK) + 1);
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            const char *name = u_getPropertyValueName(UCHAR_BLOCK, i, U_LONG_PROPERTY_NAME);
+            if (!name) continue;
+
+            // "Latin_Extended_A" -> "Latin Extended A"
+            names[i] = name;
+            std::replace(names[i].begin(), names[i].end(), '_', ' ');
+        }
+        return names;
+    }();
+
+    if (blockCode == UBLOCK_INVALID_CODE) return "Invalid Code";
+    if (blockCode < 0 || (size_t)blockCode >= names.size() || names[blockCode].empty()) return "Unknown";
+    return names[blockCode].c_str();
+}
@@ -0,0 +1,75 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "render.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <unicode/umachine.h>
+
+struct GlyphListEntry
+{
+    uint32_t charCode;
+    uint32_t glyphIndex;
+    int32_t block; // UBlockCode
+    uint32_t group; // index into GlyphList::groups
+};
+
+// Run of consecutive entries in the same Unicode block, shown as a group row
+struct GlyphListGroup
+{
+    int32_t block;
+    uint32_t begin;
+    uint32_t end;
+};
+
+// Characters of a face sorted by charcode and grouped by Unicode block
+struct GlyphList
+{
+    std::vector<GlyphListEntry> entries;
+    std::vector<GlyphListGroup> groups;
+
+    // Entry index of each charcode, built in the same pass as the entries
+    std::unordered_map<uint32_t, uint32_t> index;
+
+    // Block range of the last entry, appending continues the merge from here
+    size_t blockRange = 0;
+
+    const GlyphListEntry* find(uint32_t charCode) const;
+};
+
+// Appends charmap entries that sort after the ones already in `list`
+void appendGlyphs(GlyphList &list, const std::vector<CharMapEntry> &charMap);
+GlyphList makeGlyphList(const std::vector<CharMapEntry> &charMap);
+
+// Codepoints first..last (inclusive) all belong to `block`
+struct UnicodeBlockRange
+{
+    UChar32 first;
+    UChar32 last;
+    int32_t block; // UBlockCode
+};
+
+// Sorted ranges covering every codepoint, built once from the linked ICU data
+const std::vector<UnicodeBlockRange>& unicodeBlockRanges();
+
+// Name of a UBlockCode as the linked ICU version spells it
+const char* unicodeBlockName(int blockCode);
@@ -0,0 +1,277 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "glyph_list_model.hpp"
+#include "unicode_names.hpp"
+
+#include <cstdint>
+#include <string>
+
+static
+int nextStamp()
+{
+    static int stamp = 0;
+    return ++stamp;
+}
+
+Glib::RefPtr<GlyphListModel> GlyphListModel::create(std::shared_ptr<GlyphList> list)
+{
+    return Glib::RefPtr<GlyphListModel>(new GlyphListModel(std::move(list)));
+}
+
+GlyphListModel::GlyphListModel(std::shared_ptr<GlyphList> list)
+    : Glib::ObjectBase(typeid(GlyphListModel))
+    , Glib::Object()
+    , m_list(std::move(list))
+    , m_stamp(nextStamp())
+{
+}
+
+void GlyphListModel::append(const std::vector<CharMapEntry> &charMap)
+{
+    size_t oldGroups = m_list->groups.size();
+    size_t oldEntries = m_list->entries.size();
+    appendGlyphs(*m_list, charMap);
+
+    // New entries either extend the last group or start new groups
+    for (size_t e = oldEntries; e < m_list->entries.size(); ++e)
+    {
+        uint32_t group = m_list->entries[e].group;
+        bool firstChild = (e == m_list->groups[group].begin);
+
+        Path groupPath;
+        groupPath.push_back(group);
+        iterator groupIter;
+        setIter(groupIter, group, 0);
+
+        if (firstChild && group >= oldGroups)
+        {
+            row_inserted(groupPath, groupIter);
+        }
+
+        Path path = groupPath;
+        path.push_back(e - m_list->groups[group].begin);
+        iterator iter;
+        setIter(iter, group, e + 1);
+        row_inserted(path, iter);
+
+        if (firstChild)
+        {
+            row_has_child_toggled(groupPath, groupIter);
+        }
+    }
+}
+
+Gtk::TreeModel::Path GlyphListModel::pathOf(uint32_t charCode) const
+{
+    Path path;
+
+    const GlyphListEntry *entry = m_list->find(charCode);
+    if (entry)
+    {
+        path.push_back(entry->group);
+        path.push_back(entry - &m_list->entries[m_list->groups[entry->group].begin]);
+    }
+    return path;
+}
+
+void GlyphListModel::setIter(iterator &iter, size_t group, size_t entry) const
+{
+    iter.set_stamp(m_stamp);
+    GtkTreeIter *it = iter.gobj();
+    it->user_data = reinterpret_cast<void*>(group);
+    it->user_data2 = reinterpret_cast<void*>(entry);
+    it->user_data3 = nullptr;
+}
+
+bool GlyphListModel::isValid(const iterator &iter) const
+{
+    return iter.get_stamp() == m_stamp && groupOf(iter) < m_list->groups.size();
+}
+
+size_t GlyphListModel::groupOf(const iterator &iter)
+{
+    return reinterpret_cast<size_t>(iter.gobj()->user_data);
+}
+
+size_t GlyphListModel::entryOf(const iterator &iter)
+{
+    return reinterpret_cast<size_t>(iter.gobj()->user_data2);
+}
+
+Gtk::TreeModelFlags GlyphListModel::get_flags_vfunc() const
+{
+    return Gtk::TreeModelFlags(0);
+}
+
+int GlyphListModel::get_n_columns_vfunc() const
+{
+    return m_columns.size();
+}
+
+GType GlyphListModel::get_column_type_vfunc(int index) const
+{
+    return m_columns.types()[index];
+}
+
+void GlyphListModel::get_value_vfunc(const iterator &iter, int column, Glib::ValueBase &value) const
+{
+    if (!isValid(iter)) return;
+
+    const GlyphListGroup &group = m_list->groups[groupOf(iter)];
+    size_t entry = entryOf(iter);
+    const GlyphListEntry *glyph = entry ? &m_list->entries[entry - 1] : nullptr;
+
+    if (column == m_columns.colCharCodeInt.index())
+    {
+        Glib::Value<int> v;
+        v.init(Glib::Value<int>::value_type());
+        v.set(glyph ? (int)glyph->charCode : -1);
+        value.init(Glib::Value<int>::value_type());
+        value = v;
+        return;
+    }
+
+    Glib::ustring text;
+    if (column == m_columns.colCode.index())
+    {
+        if (glyph) text = std::to_string(glyph->charCode);
+    }
+    else if (column == m_columns.colName.index())
+    {
+        if (glyph)
+        {
+            text = unicodeCharName(glyph->charCode);
+        }
+        else
+        {
+            text = unicodeBlockName(group.block);
+        }
+    }
+
+    Glib::Value<Glib::ustring> v;
+    v.init(Glib::Value<Glib::ustring>::value_type());
+    v.set(text);
+    value.init(Glib::Value<Glib::ustring>::value_type());
+    value = v;
+}
+
+bool GlyphListModel::iter_next_vfunc(const iterator &iter, iterator &iter_next) const
+{
+    iter_next.set_stamp(0);
+    if (!isValid(iter)) return false;
+
+    size_t group = groupOf(iter);
+    size_t entry = entryOf(iter);
+
+    if (entry == 0)
+    {
+        if (group + 1 >= m_list->groups.size()) return false;
+        setIter(iter_next, group + 1, 0);
+        return true;
+    }
+
+    if (entry >= m_list->groups[group].end) return false;
+    setIter(iter_next, group, entry + 1);
+    return true;
+}
+
+bool GlyphListModel::iter_children_vfunc(const iterator &parent, iterator &iter) const
+{
+    return iter_nth_child_vfunc(parent, 0, iter);
+}
+
+bool GlyphListModel::iter_has_child_vfunc(const iterator &iter) const
+{
+    return iter_n_children_vfunc(iter) > 0;
+}
+
+int GlyphListModel::iter_n_children_vfunc(const iterator &iter) const
+{
+    if (!isValid(iter) || entryOf(iter) != 0) return 0;
+
+    const GlyphListGroup &group = m_list->groups[groupOf(iter)];
+    return group.end - group.begin;
+}
+
+int GlyphListModel::iter_n_root_children_vfunc() const
+{
+    return m_list->groups.size();
+}
+
+bool GlyphListModel::iter_nth_child_vfunc(const iterator &parent, int n, iterator &iter) const
+{
+    iter.set_stamp(0);
+    if (n < 0 || n >= iter_n_children_vfunc(parent)) return false;
+
+    size_t group = groupOf(parent);
+    setIter(iter, group, m_list->groups[group].begin + n + 1);
+    return true;
+}
+
+bool GlyphListModel::iter_nth_root_child_vfunc(int n, iterator &iter) const
+{
+    iter.set_stamp(0);
+    if (n < 0 || (size_t)n >= m_list->groups.size()) return false;
+
+    setIter(iter, n, 0);
+    return true;
+}
+
+bool GlyphListModel::iter_parent_vfunc(const iterator &child, iterator &iter) const
+{
+    iter.set_stamp(0);
+    if (!isValid(child) || entryOf(child) == 0) return false;
+
+    setIter(iter, groupOf(child), 0);
+    return true;
+}
+
+Gtk::TreeModel::Path GlyphListModel::get_path_vfunc(const iterator &iter) const
+{
+    Path path;
+    if (!isValid(iter)) return path;
+
+    size_t group = groupOf(iter);
+    path.push_back(group);
+
+    size_t entry = entryOf(iter);
+    if (entry != 0)
+    {
+        path.push_back(entry - 1 - m_list->groups[group].begin);
+    }
+    return path;
+}
+
+bool GlyphListModel::get_iter_vfunc(const Path &path, iterator &iter) const
+{
+    iter.set_stamp(0);
+    if (path.size() < 1 || path.size() > 2) return false;
+
+    int group = path[0];
+    if (group < 0 || (size_t)group >= m_list->groups.size()) return false;
+
+    if (path.size() == 1)
+    {
+        setIter(iter, group, 0);
+        return true;
+    }
+
+    iterator parent;
+    setIter(parent, group, 0);
+    return iter_nth_child_vfunc(parent, path[1], iter);
+}
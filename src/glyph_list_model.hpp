@@ -0,0 +1,86 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "glyph_list.hpp"
+
+#include <memory>
+
+#include <glibmm/object.h>
+#include <gtkmm/treemodel.h>
+
+struct FontGlyphSelectorColumns : public Gtk::TreeModel::ColumnRecord
+{
+    FontGlyphSelectorColumns()
+    {
+        add(colCode);
+        add(colName);
+        add(colCharCodeInt);
+    }
+
+    Gtk::TreeModelColumn<Glib::ustring> colCode;
+    Gtk::TreeModelColumn<Glib::ustring> colName;
+    Gtk::TreeModelColumn<int> colCharCodeInt;
+};
+
+// Tree model over a GlyphList that only grows, block groups at the top level and
+// their characters below. Row text is only formatted when the view asks for
+// it, so with a fixed height TreeView just the visible rows cost anything.
+class GlyphListModel : public Glib::Object, public Gtk::TreeModel
+{
+public:
+    static Glib::RefPtr<GlyphListModel> create(std::shared_ptr<GlyphList> list);
+
+    const GlyphList& list() const { return *m_list; }
+
+    // Appends to the list and signals the new rows to the views
+    void append(const std::vector<CharMapEntry> &charMap);
+
+    // Path of the row showing `charCode`, empty if the face does not map it
+    Path pathOf(uint32_t charCode) const;
+
+protected:
+    explicit GlyphListModel(std::shared_ptr<GlyphList> list);
+
+    Gtk::TreeModelFlags get_flags_vfunc() const override;
+    int get_n_columns_vfunc() const override;
+    GType get_column_type_vfunc(int index) const override;
+    void get_value_vfunc(const iterator &iter, int column, Glib::ValueBase &value) const override;
+
+    bool iter_next_vfunc(const iterator &iter, iterator &iter_next) const override;
+    bool iter_children_vfunc(const iterator &parent, iterator &iter) const override;
+    bool iter_has_child_vfunc(const iterator &iter) const override;
+    int iter_n_children_vfunc(const iterator &iter) const override;
+    int iter_n_root_children_vfunc() const override;
+    bool iter_nth_child_vfunc(const iterator &parent, int n, iterator &iter) const override;
+    bool iter_nth_root_child_vfunc(int n, iterator &iter) const override;
+    bool iter_parent_vfunc(const iterator &child, iterator &iter) const override;
+    Path get_path_vfunc(const iterator &iter) const override;
+    bool get_iter_vfunc(const Path &path, iterator &iter) const override;
+
+private:
+    // Iterators carry the group index and the entry index + 1, zero for group rows
+    void setIter(iterator &iter, size_t group, size_t entry) const;
+    bool isValid(const iterator &iter) const;
+    static size_t groupOf(const iterator &iter);
+    static size_t entryOf(const iterator &iter);
+
+    FontGlyphSelectorColumns m_columns;
+    std::shared_ptr<GlyphList> m_list;
+    int m_stamp;
+};
@@ -0,0 +1,336 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "glyph_painter.hpp"
+
+#include "bitmap_convert.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+static
+Cairo::RefPtr<Cairo::ImageSurface> makeBitmapSurface(const FT_Bitmap &bitmap, bool grayscaleLCD)
+{
+    auto surface = Cairo::ImageSurface::create(Cairo::FORMAT_RGB24, bitmap.width, bitmap.rows);
+    surface->flush();
+    convertBitmap(bitmap, grayscaleLCD, reinterpret_cast<uint32_t*>(surface->get_data()), surface->get_stride());
+    surface->mark_dirty();
+    return surface;
+}
+
+// Grid lines closer than this many device pixels are not drawn
+static const double kMinGridPixelPitch = 4.0;
+
+bool GlyphPainter::setGlyph(RenderedGlyphPtr glyph)
+{
+    m_glyph = std::move(glyph);
+    m_bitmapSurface.clear();
+    m_drawable = m_glyph && bitmapGeometry(m_glyph->bitmap, m_geometry);
+    return m_drawable;
+}
+
+PixelRect GlyphPainter::visiblePixels(const Cairo::Matrix &viewMatrix, double width, double height) const
+{
+    Cairo::Matrix inv = viewMatrix;
+    inv.invert();
+
+    PixelRect r = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+    for (auto [x, y] : { std::pair<double, double>{ 0, 0 }, { width, 0 }, { 0, height }, { width, height } })
+    {
+        inv.transform_point(x, y);
+        r.x1 = std::min(r.x1, x);
+        r.y1 = std::min(r.y1, y);
+        r.x2 = std::max(r.x2, x);
+        r.y2 = std::max(r.y2, y);
+    }
+
+    // Glyph space -> bitmap space
+    r.x1 -= m_glyph->bitmap_left;
+    r.x2 -= m_glyph->bitmap_left;
+    r.y1 += m_glyph->bitmap_top;
+    r.y2 += m_glyph->bitmap_top;
+    return r;
+}
+
+void GlyphPainter::drawBitmapImage(const Cairo::RefPtr<Cairo::Context>& cr, const PixelRect &visible, bool grayscaleLCD)
+{
+    TRACE_SCOPE("draw", "drawBitmapImage");
+    double pixelWidth = m_geometry.columnWidth;
+    double pixelHeight = m_geometry.rowHeight;
+
+    auto &bitmap = m_glyph->bitmap;
+    if (bitmap.width == 0 || bitmap.rows == 0) return;
+
+    if (!m_bitmapSurface || m_bitmapSurfaceGrayscaleLCD != grayscaleLCD)
+    {
+        m_bitmapSurface = makeBitmapSurface(bitmap, grayscaleLCD);
+        m_bitmapSurfaceGrayscaleLCD = grayscaleLCD;
+    }
+
+    // One bitmap pixel (or LCD subpixel) is one surface pixel, scaled up without smoothing
+    auto pattern = Cairo::SurfacePattern::create(m_bitmapSurface);
+    pattern->set_filter(Cairo::FILTER_NEAREST);
+
+    cr->save();
+    cr->translate(m_glyph->bitmap_left, -m_glyph->bitmap_top);
+    cr->scale(pixelWidth, pixelHeight);
+    cr->set_source(pattern);
+
+    // Only fill the on screen part, a zoomed in view costs the same for any bitmap size
+    double x1 = std::max(0.0, floor(visible.x1 / pixelWidth));
+    double y1 = std::max(0.0, floor(visible.y1 / pixelHeight));
+    double x2 = std::min((double)bitmap.width, ceil(visible.x2 / pixelWidth));
+    double y2 = std::min((double)bitmap.rows, ceil(visible.y2 / pixelHeight));
+    if (x1 < x2 && y1 < y2)
+    {
+        cr->rectangle(x1, y1, x2 - x1, y2 - y1);
+        cr->fill();
+    }
+    cr->restore();
+}
+
+void GlyphPainter::drawBitmapPerPixel(const Cairo::RefPtr<Cairo::Context>& cr, const PixelRect &visible, bool grayscaleLCD)
+{
+    TRACE_SCOPE("draw", "drawBitmapPerPixel");
+    double pixelWidth = m_geometry.columnWidth;
+    double pixelHeight = m_geometry.rowHeight;
+
+    auto &bitmap = m_glyph->bitmap;
+
+    int xBegin = std::max(0, (int)floor(visible.x1 / pixelWidth));
+    int yBegin = std::max(0, (int)floor(visible.y1 / pixelHeight));
+    int xEnd = std::min((int)bitmap.width, (int)ceil(visible.x2 / pixelWidth));
+    int yEnd = std::min((int)bitmap.rows, (int)ceil(visible.y2 / pixelHeight));
+
+    cr->save();
+    cr->translate(m_glyph->bitmap_left, -m_glyph->bitmap_top);
+
+    for (int y = yBegin; y < yEnd; ++y)
+    {
+        const uint8_t *row_buf = bitmapRow(bitmap, y);
+
+        if (bitmap.pixel_mode == FT_PIXEL_MODE_BGRA)
+        {
+            for (int x = xBegin; x < xEnd; ++x)
+            {
+                double b = row_buf[x*4 + 0] / 255.0;
+                double g = row_buf[x*4 + 1] / 255.0;
+                double r = row_buf[x*4 + 2] / 255.0;
+                double a = row_buf[x*4 + 3] / 255.0;
+
+                // Make pixels overlap a bit to get rid of rendering artifacts
+                double overlap = 0.01;
+                cr->set_source_rgb(r, g, b);
+                cr->move_to(-overlap + pixelWidth * x, -overlap + pixelHeight * y);
+                cr->rel_line_to(0, pixelHeight + 2*overlap);
+                cr->rel_line_to(pixelWidth + 2*overlap, 0);
+                cr->rel_line_to(0, -pixelHeight - 2*overlap);
+                cr->fill();
+            }
+        }
+        else
+        {
+            for (int x = xBegin; x < xEnd; ++x)
+            {
+                double gray = 0;
+
+                double r, g, b;
+                if (bitmap.pixel_mode == FT_PIXEL_MODE_MONO)
+                {
+                    uint32_t byte = row_buf[x/8];
+                    byte &= (((uint32_t)1) << (7-(x%8)));
+                    gray = byte ? 1.0 : 0.0;
+                    r = b = g= gray;
+                }
+                else
+                {
+                    gray = row_buf[x] / 255.0;
+                    if (bitmap.pixel_mode == FT_PIXEL_MODE_GRAY || grayscaleLCD)
+                    {
+                        r = g = b = gray;
+                    }
+                    else if (bitmap.pixel_mode == FT_PIXEL_MODE_LCD)
+                    {
+                        r = (x % 3 == 0) * gray;
+                        g = (x % 3 == 1) * gray;
+                        b = (x % 3 == 2) * gray;
+                    }
+                    else if (bitmap.pixel_mode == FT_PIXEL_MODE_LCD_V)
+                    {
+                        r = (y % 3 == 0) * gray;
+                        g = (y % 3 == 1) * gray;
+                        b = (y % 3 == 2) * gray;
+                    }
+                }
+
+                double overlap = 0.01;
+                cr->set_source_rgb(r, g, b);
+                cr->move_to(-overlap + pixelWidth * x, -overlap + pixelHeight * y);
+                cr->rel_line_to(0, pixelHeight + 2*overlap);
+                cr->rel_line_to(pixelWidth + 2*overlap, 0);
+                cr->rel_line_to(0, -pixelHeight - 2*overlap);
+                cr->fill();
+            }
+        }
+    }
+    cr->restore();
+}
+
+void GlyphPainter::drawGrid(const Cairo::RefPtr<Cairo::Context>& cr, const PixelRect &visible)
+{
+    TRACE_SCOPE("draw", "drawGrid");
+    // Zoomed far out the grid would just be a solid wash, skip it
+    Cairo::Matrix matrix;
+    cr->get_matrix(matrix);
+    double pixelPitch = std::hypot(matrix.xx, matrix.yx);
+    if (pixelPitch < kMinGridPixelPitch) return;
+
+    int bitmapWidth = m_geometry.width;
+    int bitmapHeight = m_geometry.height;
+
+    int extend = 10;
+    double x1 = std::max<double>(0 - extend, floor(visible.x1));
+    double y1 = std::max<double>(0 - extend, floor(visible.y1));
+    double x2 = std::min<double>(bitmapWidth + extend, ceil(visible.x2));
+    double y2 = std::min<double>(bitmapHeight + extend, ceil(visible.y2));
+    if (x1 > x2 || y1 > y2) return;
+
+    cr->save();
+    cr->set_source_rgb(0.15, 0.15, 0.15);
+    cr->translate(m_glyph->bitmap_left, -m_glyph->bitmap_top);
+
+    for (int i = x1; i <= x2; ++i)
+    {
+        cr->move_to(i, y1);
+        cr->line_to(i, y2);
+    }
+    for (int i = y1; i <= y2; ++i)
+    {
+        cr->move_to(x1, i);
+        cr->line_to(x2, i);
+    }
+    cr->stroke();
+    cr->restore();
+}
+
+void GlyphPainter::drawScene(const Cairo::RefPtr<Cairo::Context>& cr, const PixelRect &visible, const PaintOptions &options,
+                             PaintTimings *timings)
+{
+    int bitmapWidth = m_geometry.width;
+    int bitmapHeight = m_geometry.height;
+
+    std::chrono::steady_clock::time_point lap;
+    if (timings) lap = std::chrono::steady_clock::now();
+
+    cr->set_line_width(0.1);
+
+    cr->save();
+    cr->set_source_rgba(0, 0, 0, 1);
+    cr->paint();
+    cr->restore();
+
+    if (options.perPixel)
+    {
+        drawBitmapPerPixel(cr, visible, options.grayscaleLCD);
+    }
+    else
+    {
+        drawBitmapImage(cr, visible, options.grayscaleLCD);
+    }
+
+    if (timings) addLapTime(lap, timings->bitmap);
+
+    if (options.grid)
+    {
+        drawGrid(cr, visible);
+    }
+    if (timings) addLapTime(lap, timings->grid);
+
+    {
+        double x1 = 0;
+        double y1 = 0;
+        double x2 = bitmapWidth;
+        double y2 = bitmapHeight;
+        cr->save();
+        cr->translate(m_glyph->bitmap_left, -m_glyph->bitmap_top);
+
+        cr->set_source_rgb(0.4, 0.4, 0.4);
+        cr->move_to(x1, y1);
+        cr->line_to(x2, y1);
+        cr->line_to(x2, y2);
+        cr->line_to(x1, y2);
+        cr->close_path();
+        cr->stroke();
+
+        cr->restore();
+    }
+    if (timings) addLapTime(lap, timings->bitmap);
+
+    if (options.outline && !m_glyph->outlinePath.empty())
+    {
+        TRACE_SCOPE("draw", "outline");
+
+        // Path data is owned by the glyph. Cairo::Path can't wrap a path it
+        // doesn't own (it leaves cobj() null), so the C API is used directly.
+        cairo_path_t path;
+        path.status = CAIRO_STATUS_SUCCESS;
+        path.data = const_cast<cairo_path_data_t*>(m_glyph->outlinePath.data());
+        path.num_data = m_glyph->outlinePath.size();
+
+        cr->save();
+        cr->set_source_rgb(45.0/255, 206.0/255, 160.0/255);
+        cairo_append_path(cr->cobj(), &path);
+        cr->stroke();
+        cr->restore();
+    }
+    if (timings) addLapTime(lap, timings->outline);
+
+    if (options.baseline)
+    {
+        TRACE_SCOPE("draw", "baseline");
+        cr->save();
+
+        cr->set_source_rgb(0, 1, 1);
+
+        if (options.horizontal)
+        {
+            cr->arc(0, 0, 0.1, 0, 2 * M_PI);
+            cr->fill();
+
+            cr->move_to(0, 0);
+            cr->line_to(m_glyph->advance.x * (1.0 / 64), -m_glyph->advance.y * (1.0 / 64));
+            cr->stroke();
+        }
+        else
+        {
+            cr->translate(-m_glyph->metrics.vertBearingX / 64,
+                -m_glyph->bitmap_top - m_glyph->metrics.vertBearingY / 64);
+            cr->arc(0, 0, 0.1, 0, 2 * M_PI);
+            cr->fill();
+
+            cr->move_to(0, 0);
+            cr->line_to(-m_glyph->advance.x * (1.0 / 64), m_glyph->advance.y * (1.0 / 64));
+            cr->stroke();
+        }
+
+        cr->restore();
+    }
+    if (timings) addLapTime(lap, timings->baseline);
+}
@@ -0,0 +1,87 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "bitmap_convert.hpp"
+#include "render.hpp"
+
+#include <cairomm/context.h>
+#include <cairomm/surface.h>
+
+// Axis aligned rectangle in bitmap pixel units, origin at the bitmap's top left
+struct PixelRect
+{
+    double x1, y1, x2, y2;
+};
+
+// What drawScene() shows besides the bitmap
+struct PaintOptions
+{
+    bool grayscaleLCD = false;
+    bool baseline = false;
+    bool grid = false;
+    bool outline = false;
+    // Fills every pixel separately, the old path kept for comparison
+    bool perPixel = false;
+    bool horizontal = true;
+};
+
+// Milliseconds drawScene() spent on each layer, added up over calls
+struct PaintTimings
+{
+    // Background, bitmap and bounding box
+    double bitmap = 0;
+    double grid = 0;
+    double outline = 0;
+    double baseline = 0;
+};
+
+// Draws a magnified RenderedGlyph in glyph space (one unit per pixel, y
+// down, origin at the pen position) without depending on a widget, for the
+// drawer's tiles and for offscreen use.
+class GlyphPainter
+{
+public:
+    // Returns false if the glyph can't be drawn, drawScene() must not be
+    // called then
+    bool setGlyph(RenderedGlyphPtr glyph);
+    bool drawable() const { return m_drawable; }
+    const BitmapGeometry& geometry() const { return m_geometry; }
+
+    // Part of the bitmap plane under the device rectangle (0, 0)-(width, height)
+    PixelRect visiblePixels(const Cairo::Matrix &viewMatrix, double width, double height) const;
+
+    // Background, bitmap, bounding box and the optional layers, clipped to
+    // `visible`. `cr` maps glyph space to the device. Layers are timed into
+    // `timings` unless it is null.
+    void drawScene(const Cairo::RefPtr<Cairo::Context>& cr, const PixelRect &visible, const PaintOptions &options,
+                   PaintTimings *timings = nullptr);
+
+private:
+    void drawBitmapImage(const Cairo::RefPtr<Cairo::Context>& cr, const PixelRect &visible, bool grayscaleLCD);
+    void drawBitmapPerPixel(const Cairo::RefPtr<Cairo::Context>& cr, const PixelRect &visible, bool grayscaleLCD);
+    void drawGrid(const Cairo::RefPtr<Cairo::Context>& cr, const PixelRect &visible);
+
+    RenderedGlyphPtr m_glyph;
+    bool m_drawable = false;
+    BitmapGeometry m_geometry = {};
+
+    // Glyph bitmap converted to screen colors, rebuilt lazily after setGlyph()
+    Cairo::RefPtr<Cairo::ImageSurface> m_bitmapSurface;
+    bool m_bitmapSurfaceGrayscaleLCD = false;
+};
@@ -0,0 +1,198 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "glyph_search.hpp"
+#include "trace.hpp"
+#include "unicode_names.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+// Checked for cancellation every this many charcodes
+static const size_t kCancelCheckInterval = 1024;
+
+static
+uint32_t trigramKey(const char *s)
+{
+    return ((uint32_t)(unsigned char)s[0] << 16) | ((uint32_t)(unsigned char)s[1] << 8) | (unsigned char)s[2];
+}
+
+std::shared_ptr<const GlyphSearchIndex> GlyphSearchIndex::build(std::shared_ptr<const FaceInfo> face,
+    std::vector<uint32_t> charCodes, const std::function<bool()> &cancelled)
+{
+    auto index = std::make_shared<GlyphSearchIndex>();
+    index->m_face = std::move(face);
+    index->m_charCodes = std::move(charCodes);
+    index->m_textOffsets.reserve(index->m_charCodes.size());
+
+    for (size_t i = 0; i < index->m_charCodes.size(); ++i)
+    {
+        if (i % kCancelCheckInterval == 0 && cancelled()) return nullptr;
+
+        uint32_t charCode = index->m_charCodes[i];
+        char codeBuf[16];
+        sprintf(codeBuf, " U+%04X", charCode);
+
+        uint32_t offset = index->m_text.size();
+        index->m_textOffsets.push_back(offset);
+        index->m_text += unicodeCharName(charCode);
+        index->m_text += codeBuf;
+
+        for (size_t j = offset; j + 3 <= index->m_text.size(); ++j)
+        {
+            auto &postings = index->m_trigrams[trigramKey(&index->m_text[j])];
+            if (postings.empty() || postings.back() != i)
+            {
+                postings.push_back(i);
+            }
+        }
+        index->m_text += '\0';
+    }
+
+    return index;
+}
+
+std::vector<uint32_t> GlyphSearchIndex::search(const std::string &query) const
+{
+    std::vector<std::string> words;
+    {
+        std::istringstream ss(query);
+        std::string word;
+        while (ss >> word)
+        {
+            for (char &c : word) c = toupper((unsigned char)c);
+            words.push_back(std::move(word));
+        }
+    }
+
+    std::vector<uint32_t> result;
+    if (words.empty()) return result;
+
+    // Only the rarest trigram's charcodes need checking, a missing one means no match
+    const std::vector<uint32_t> *candidates = nullptr;
+    for (const std::string &word : words)
+    {
+        for (size_t j = 0; j + 3 <= word.size(); ++j)
+        {
+            auto it = m_trigrams.find(trigramKey(&word[j]));
+            if (it == m_trigrams.end()) return result;
+
+            if (!candidates || it->second.size() < candidates->size())
+            {
+                candidates = &it->second;
+            }
+        }
+    }
+
+    auto matches = [&](uint32_t i)
+    {
+        const char *text = &m_text[m_textOffsets[i]];
+        for (const std::string &word : words)
+        {
+            if (!strstr(text, word.c_str())) return false;
+        }
+        return true;
+    };
+
+    if (candidates)
+    {
+        for (uint32_t i : *candidates)
+        {
+            if (matches(i)) result.push_back(m_charCodes[i]);
+        }
+    }
+    else
+    {
+        // Only words shorter than a trigram, check everything
+        for (uint32_t i = 0; i < m_charCodes.size(); ++i)
+        {
+            if (matches(i)) result.push_back(m_charCodes[i]);
+        }
+    }
+
+    return result;
+}
+
+GlyphSearchIndexer::GlyphSearchIndexer(std::function<void()> notify)
+    : m_notify(std::move(notify))
+{
+    m_thread = std::thread([this]()
+    {
+        setTraceThreadName("glyph search");
+        run();
+    });
+}
+
+GlyphSearchIndexer::~GlyphSearchIndexer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+}
+
+void GlyphSearchIndexer::post(std::shared_ptr<const FaceInfo> face, std::vector<uint32_t> charCodes)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = Job{ std::move(face), std::move(charCodes) };
+    }
+    m_cond.notify_one();
+}
+
+std::shared_ptr<const GlyphSearchIndex> GlyphSearchIndexer::takeResult()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::move(m_result);
+}
+
+void GlyphSearchIndexer::run()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return m_stop || m_pending; });
+            if (m_stop) return;
+
+            job = std::move(*m_pending);
+            m_pending.reset();
+        }
+
+        std::shared_ptr<const GlyphSearchIndex> index;
+        {
+            TRACE_SCOPE("search", "GlyphSearchIndex::build");
+            index = GlyphSearchIndex::build(std::move(job.face), std::move(job.charCodes), [this]()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_stop || m_pending.has_value();
+            });
+        }
+        if (!index) continue;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_result = std::move(index);
+        }
+        m_notify();
+    }
+}
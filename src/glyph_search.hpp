@@ -0,0 +1,95 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "render.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Trigram index over the Unicode names and "U+XXXX" codepoints of a face's
+// characters
+class GlyphSearchIndex
+{
+public:
+    // Returns nullptr if `cancelled` returns true while building
+    static std::shared_ptr<const GlyphSearchIndex> build(std::shared_ptr<const FaceInfo> face,
+        std::vector<uint32_t> charCodes, const std::function<bool()> &cancelled);
+
+    const std::shared_ptr<const FaceInfo>& face() const { return m_face; }
+
+    // Charcodes whose name or codepoint contains every space separated word
+    // of `query`, ignoring case, sorted
+    std::vector<uint32_t> search(const std::string &query) const;
+
+private:
+    std::shared_ptr<const FaceInfo> m_face;
+    std::vector<uint32_t> m_charCodes;
+
+    // Upper case "NAME U+XXXX" of each charcode, NUL terminated, at m_textOffsets[i]
+    std::string m_text;
+    std::vector<uint32_t> m_textOffsets;
+
+    // Three packed characters -> sorted indices of the charcodes containing them
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_trigrams;
+};
+
+// Builds search indexes on a background thread. Like RenderWorker only the
+// latest posted face matters, posting cancels a build still in progress.
+class GlyphSearchIndexer
+{
+public:
+    // `notify` is called on the indexer thread each time an index is ready
+    explicit GlyphSearchIndexer(std::function<void()> notify);
+    ~GlyphSearchIndexer();
+
+    GlyphSearchIndexer(const GlyphSearchIndexer&) = delete;
+    GlyphSearchIndexer& operator=(const GlyphSearchIndexer&) = delete;
+
+    void post(std::shared_ptr<const FaceInfo> face, std::vector<uint32_t> charCodes);
+
+    // Latest finished index, nullptr if there is nothing new
+    std::shared_ptr<const GlyphSearchIndex> takeResult();
+
+private:
+    struct Job
+    {
+        std::shared_ptr<const FaceInfo> face;
+        std::vector<uint32_t> charCodes;
+    };
+
+    void run();
+
+    std::function<void()> m_notify;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop = false;
+    std::optional<Job> m_pending;
+    std::shared_ptr<const GlyphSearchIndex> m_result;
+
+    std::thread m_thread;
+};
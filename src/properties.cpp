@@ -22,6 +22,7 @@
 #include <gtkmm/label.h>
 
 
+#include <cinttypes>
 #include <vector>
 #include <functional>
 
@@ -37,6 +38,36 @@ static std::string fmtInt(int v)
     return buf;
 }
 
+static std::string fmtCount(uint64_t v)
+{
+    char buf[30];
+    sprintf(buf, "%" PRIu64, v);
+    return buf;
+}
+
+static std::string fmtBytes(size_t v)
+{
+    char buf[30];
+    sprintf(buf, "%.1f MiB", v / (1024.0 * 1024.0));
+    return buf;
+}
+
+// Strikes as "width x height" pixels, "none" for scalable faces
+static std::string fmtBitmapSizes(const std::vector<FT_Bitmap_Size> &sizes)
+{
+    if (sizes.empty()) return "none";
+
+    std::string res;
+    for (const FT_Bitmap_Size &size : sizes)
+    {
+        char buf[30];
+        sprintf(buf, "%dx%d", size.width, size.height);
+        if (!res.empty()) res += ", ";
+        res += buf;
+    }
+    return res;
+}
+
 static std::string fmtPixelMode(unsigned char mode)
 {
     switch (mode)
@@ -144,7 +175,7 @@ Gtk::Widget& makePropertiesWidget(Signals &signals)
         addSeparator();
     };
 
-    auto addProp = [&](const char *label, std::function<std::string(FT_Face)> fn)
+    auto addProp = [&](const char *label, std::function<std::string(const RenderedGlyph&)> fn)
     {
         auto *nameLabel = Gtk::make_managed<Gtk::Label>(label);
         nameLabel->show();
@@ -156,61 +187,105 @@ Gtk::Widget& makePropertiesWidget(Signals &signals)
         valLabel->set_xalign(1);
         lastGrid->attach_next_to(*valLabel, *nameLabel, Gtk::PositionType::POS_RIGHT);
 
-        signals.font_reloaded.connect([=](FT_Face face)
+        signals.font_reloaded.connect([=](const RenderedGlyph &glyph)
         {
-            std::string res = fn(face);
+            std::string res = fn(glyph);
             valLabel->set_label(res);
         });
 
         addSeparator();
     };
 
+    auto addStat = [&](const char *label, std::function<std::string(const Stats&)> fn)
+    {
+        auto *nameLabel = Gtk::make_managed<Gtk::Label>(label);
+        nameLabel->show();
+        nameLabel->set_xalign(0);
+        lastGrid->attach_next_to(*nameLabel, Gtk::PositionType::POS_BOTTOM);
+
+        auto *valLabel = Gtk::make_managed<Gtk::Label>("");
+        valLabel->show();
+        valLabel->set_xalign(1);
+        lastGrid->attach_next_to(*valLabel, *nameLabel, Gtk::PositionType::POS_RIGHT);
+
+        signals.stats_updated.connect([=](const Stats &stats)
+        {
+            valLabel->set_label(fn(stats));
+        });
+
+        addSeparator();
+    };
+
     // TODO normalize these
     addTitle("face");
-    addProp("BBox xMin",          [](FT_Face f) { return fmtFixed26_6(f->bbox.xMin           ); });
-    addProp("BBox yMin",          [](FT_Face f) { return fmtFixed26_6(f->bbox.yMin           ); });
-    addProp("BBox xMax",          [](FT_Face f) { return fmtFixed26_6(f->bbox.xMax           ); });
-    addProp("BBox yMax",          [](FT_Face f) { return fmtFixed26_6(f->bbox.yMax           ); });
-    addProp("Units per EM",       [](FT_Face f) { return fmtFixed26_6(f->units_per_EM        ); });
-    addProp("Ascender",           [](FT_Face f) { return fmtFixed26_6(f->ascender            ); });
-    addProp("Descender",          [](FT_Face f) { return fmtFixed26_6(f->descender           ); });
-    addProp("Height",             [](FT_Face f) { return fmtFixed26_6(f->height              ); });
-    addProp("MaxAdvanceWidth",    [](FT_Face f) { return fmtFixed26_6(f->max_advance_width   ); });
-    addProp("MaxAdvanceHeight",   [](FT_Face f) { return fmtFixed26_6(f->max_advance_height  ); });
-    addProp("UnderlinePosition",  [](FT_Face f) { return fmtFixed26_6(f->underline_position  ); });
-    addProp("UnderlineThickness", [](FT_Face f) { return fmtFixed26_6(f->underline_thickness ); });
+    addProp("BBox xMin",          [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->bbox.xMin           ); });
+    addProp("BBox yMin",          [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->bbox.yMin           ); });
+    addProp("BBox xMax",          [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->bbox.xMax           ); });
+    addProp("BBox yMax",          [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->bbox.yMax           ); });
+    addProp("Units per EM",       [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->units_per_EM        ); });
+    addProp("Ascender",           [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->ascender            ); });
+    addProp("Descender",          [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->descender           ); });
+    addProp("Height",             [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->height              ); });
+    addProp("MaxAdvanceWidth",    [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->max_advance_width   ); });
+    addProp("MaxAdvanceHeight",   [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->max_advance_height  ); });
+    addProp("UnderlinePosition",  [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->underline_position  ); });
+    addProp("UnderlineThickness", [](const RenderedGlyph &g) { return fmtFixed26_6(g.face->underline_thickness ); });
+    addProp("Fixed sizes",        [](const RenderedGlyph &g) { return fmtBitmapSizes(g.face->available_sizes   ); });
 
     addTitle("face->glyph");
-    addProp("glyph-index",       [](FT_Face f) { return fmtInt(        f->glyph->glyph_index       ); });
-    addProp("linearHoriAdvance", [](FT_Face f) { return fmtFixed16_16( f->glyph->linearHoriAdvance ); });
-    addProp("linearVertAdvance", [](FT_Face f) { return fmtFixed16_16( f->glyph->linearVertAdvance ); });
-    addProp("advance.x",         [](FT_Face f) { return fmtFixed26_6(  f->glyph->advance.x         ); });
-    addProp("advance.y",         [](FT_Face f) { return fmtFixed26_6(  f->glyph->advance.y         ); });
-    addProp("format",            [](FT_Face f) { return fmtGlyphFormat(f->glyph->format            ); });
-    addProp("bitmap_left",       [](FT_Face f) { return fmtInt(        f->glyph->bitmap_left       ); });
-    addProp("bitmap_top",        [](FT_Face f) { return fmtInt(        f->glyph->bitmap_top        ); });
+    addProp("glyph-index",       [](const RenderedGlyph &g) { return fmtInt(        g.glyph_index       ); });
+    addProp("linearHoriAdvance", [](const RenderedGlyph &g) { return fmtFixed16_16( g.linearHoriAdvance ); });
+    addProp("linearVertAdvance", [](const RenderedGlyph &g) { return fmtFixed16_16( g.linearVertAdvance ); });
+    addProp("advance.x",         [](const RenderedGlyph &g) { return fmtFixed26_6(  g.advance.x         ); });
+    addProp("advance.y",         [](const RenderedGlyph &g) { return fmtFixed26_6(  g.advance.y         ); });
+    addProp("format",            [](const RenderedGlyph &g) { return fmtGlyphFormat(g.format            ); });
+    addProp("bitmap_left",       [](const RenderedGlyph &g) { return fmtInt(        g.bitmap_left       ); });
+    addProp("bitmap_top",        [](const RenderedGlyph &g) { return fmtInt(        g.bitmap_top        ); });
     // outline
     // num_subglyphs;
     // subglyphs;
-    addProp("lsb_delta",         [](FT_Face f) { return fmtFixed26_6(  f->glyph->lsb_delta         ); });
-    addProp("rsb_delta",         [](FT_Face f) { return fmtFixed26_6(  f->glyph->rsb_delta         ); });
+    addProp("lsb_delta",         [](const RenderedGlyph &g) { return fmtFixed26_6(  g.lsb_delta         ); });
+    addProp("rsb_delta",         [](const RenderedGlyph &g) { return fmtFixed26_6(  g.rsb_delta         ); });
 
     addTitle("face->glyph->bitmap");
-    addProp("rows" ,      [](FT_Face f) { return fmtInt(       f->glyph->bitmap.rows        ); });
-    addProp("width",      [](FT_Face f) { return fmtInt(       f->glyph->bitmap.width       ); });
-    addProp("pitch",      [](FT_Face f) { return fmtInt(       f->glyph->bitmap.pitch       ); });
-    addProp("num_grays",  [](FT_Face f) { return fmtInt(       f->glyph->bitmap.num_grays   ); });
-    addProp("pixel_mode", [](FT_Face f) { return fmtPixelMode( f->glyph->bitmap.pixel_mode  ); });
+    addProp("rows" ,      [](const RenderedGlyph &g) { return fmtInt(       g.bitmap.rows        ); });
+    addProp("width",      [](const RenderedGlyph &g) { return fmtInt(       g.bitmap.width       ); });
+    addProp("pitch",      [](const RenderedGlyph &g) { return fmtInt(       g.bitmap.pitch       ); });
+    addProp("num_grays",  [](const RenderedGlyph &g) { return fmtInt(       g.bitmap.num_grays   ); });
+    addProp("pixel_mode", [](const RenderedGlyph &g) { return fmtPixelMode( g.bitmap.pixel_mode  ); });
 
     addTitle("face->glyph->metrics");
-    addProp("width",        [](FT_Face f) { return fmtFixed26_6( f->glyph->metrics.width        ); });
-    addProp("height",       [](FT_Face f) { return fmtFixed26_6( f->glyph->metrics.height       ); });
-    addProp("horiBearingX", [](FT_Face f) { return fmtFixed26_6( f->glyph->metrics.horiBearingX ); });
-    addProp("horiBearingY", [](FT_Face f) { return fmtFixed26_6( f->glyph->metrics.horiBearingY ); });
-    addProp("horiAdvance",  [](FT_Face f) { return fmtFixed26_6( f->glyph->metrics.horiAdvance  ); });
-    addProp("vertBearingX", [](FT_Face f) { return fmtFixed26_6( f->glyph->metrics.vertBearingX ); });
-    addProp("vertBearingY", [](FT_Face f) { return fmtFixed26_6( f->glyph->metrics.vertBearingY ); });
-    addProp("vertAdvance",  [](FT_Face f) { return fmtFixed26_6( f->glyph->metrics.vertAdvance  ); });
+    addProp("width",        [](const RenderedGlyph &g) { return fmtFixed26_6( g.metrics.width        ); });
+    addProp("height",       [](const RenderedGlyph &g) { return fmtFixed26_6( g.metrics.height       ); });
+    addProp("horiBearingX", [](const RenderedGlyph &g) { return fmtFixed26_6( g.metrics.horiBearingX ); });
+    addProp("horiBearingY", [](const RenderedGlyph &g) { return fmtFixed26_6( g.metrics.horiBearingY ); });
+    addProp("horiAdvance",  [](const RenderedGlyph &g) { return fmtFixed26_6( g.metrics.horiAdvance  ); });
+    addProp("vertBearingX", [](const RenderedGlyph &g) { return fmtFixed26_6( g.metrics.vertBearingX ); });
+    addProp("vertBearingY", [](const RenderedGlyph &g) { return fmtFixed26_6( g.metrics.vertBearingY ); });
+    addProp("vertAdvance",  [](const RenderedGlyph &g) { return fmtFixed26_6( g.metrics.vertAdvance  ); });
+
+    addTitle("statistics");
+    addStat("Renders posted",    [](const Stats &s) { return fmtCount(s.rendersPosted    ); });
+    addStat("Renders coalesced", [](const Stats &s) { return fmtCount(s.rendersCoalesced ); });
+    addStat("Face cache hits",   [](const Stats &s) { return fmtCount(s.faceCache.hits  ); });
+    addStat("Face cache misses", [](const Stats &s) { return fmtCount(s.faceCache.misses); });
+    addStat("Face cache evictions", [](const Stats &s) { return fmtCount(s.faceCache.evictions); });
+    addStat("Face cache faces",  [](const Stats &s) { return fmtCount(s.faceCache.faces ); });
+    addStat("Face cache memory", [](const Stats &s)
+    {
+        return fmtBytes(s.faceCache.bytes) + " / " + fmtBytes(s.faceCache.budget);
+    });
+    addStat("Glyph cache hits (est.)",   [](const Stats &s) { return fmtCount(s.glyphCache.hits  ); });
+    addStat("Glyph cache misses (est.)", [](const Stats &s) { return fmtCount(s.glyphCache.misses); });
+    addStat("Glyph cache bypassed", [](const Stats &s) { return fmtCount(s.glyphCache.uncached); });
+    addStat("Glyph cache budget",   [](const Stats &s) { return fmtBytes(s.glyphCache.budget  ); });
+    addStat("Result cache hits",    [](const Stats &s) { return fmtCount(s.resultCache.hits   ); });
+    addStat("Result cache misses",  [](const Stats &s) { return fmtCount(s.resultCache.misses ); });
+    addStat("Result cache glyphs",  [](const Stats &s) { return fmtCount(s.resultCache.entries); });
+    addStat("Result cache memory",  [](const Stats &s)
+    {
+        return fmtBytes(s.resultCache.bytes) + " / " + fmtBytes(s.resultCache.budget);
+    });
 
     return *propsWrap;
 }
@@ -0,0 +1,274 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "render.hpp"
+
+#include "trace.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include <freetype/ftoutln.h>
+
+std::runtime_error FreetypeError(FT_Error errorCode, const char *method)
+{
+    char buf[1000];
+    sprintf(buf, "FreeType error: %s: (%d) %s", method, errorCode, FT_Error_String(errorCode));
+    return std::runtime_error(buf);
+}
+
+namespace {
+
+struct OutlinePathBuilder
+{
+    std::vector<cairo_path_data_t> data;
+    bool contourOpen = false;
+    double lastX = 0;
+    double lastY = 0;
+
+    void header(cairo_path_data_type_t type, int length)
+    {
+        cairo_path_data_t d;
+        d.header.type = type;
+        d.header.length = length;
+        data.push_back(d);
+    }
+
+    void point(double x, double y)
+    {
+        cairo_path_data_t d;
+        d.point.x = x;
+        d.point.y = y;
+        data.push_back(d);
+        lastX = x;
+        lastY = y;
+    }
+
+    void closeContour()
+    {
+        if (contourOpen)
+        {
+            header(CAIRO_PATH_CLOSE_PATH, 1);
+        }
+        contourOpen = false;
+    }
+
+    static int moveTo(const FT_Vector *to, void *user)
+    {
+        auto *b = reinterpret_cast<OutlinePathBuilder*>(user);
+        b->closeContour();
+        b->header(CAIRO_PATH_MOVE_TO, 2);
+        b->point(to->x / 64.0, -to->y / 64.0);
+        b->contourOpen = true;
+        return 0;
+    }
+
+    static int lineTo(const FT_Vector *to, void *user)
+    {
+        auto *b = reinterpret_cast<OutlinePathBuilder*>(user);
+        b->header(CAIRO_PATH_LINE_TO, 2);
+        b->point(to->x / 64.0, -to->y / 64.0);
+        return 0;
+    }
+
+    static int conicTo(const FT_Vector *control, const FT_Vector *to, void *user)
+    {
+        auto *b = reinterpret_cast<OutlinePathBuilder*>(user);
+
+        // Elevate degree to use with cubic cairo curve fn
+        // Adapted from https://lists.cairographics.org/archives/cairo/2010-April/019691.html
+
+        double x0 = b->lastX;
+        double y0 = b->lastY;
+        double x1 = control->x / 64.0;
+        double y1 = -control->y / 64.0;
+        double x2 = to->x / 64.0;
+        double y2 = -to->y / 64.0;
+
+        b->header(CAIRO_PATH_CURVE_TO, 4);
+        b->point(2.0 / 3.0 * x1 + 1.0 / 3.0 * x0, 2.0 / 3.0 * y1 + 1.0 / 3.0 * y0);
+        b->point(2.0 / 3.0 * x1 + 1.0 / 3.0 * x2, 2.0 / 3.0 * y1 + 1.0 / 3.0 * y2);
+        b->point(x2, y2);
+        return 0;
+    }
+
+    static int cubicTo(const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to, void *user)
+    {
+        auto *b = reinterpret_cast<OutlinePathBuilder*>(user);
+        b->header(CAIRO_PATH_CURVE_TO, 4);
+        b->point(control1->x / 64.0, -control1->y / 64.0);
+        b->point(control2->x / 64.0, -control2->y / 64.0);
+        b->point(to->x / 64.0, -to->y / 64.0);
+        return 0;
+    }
+};
+
+}
+
+std::vector<cairo_path_data_t> decomposeOutline(const FT_Outline &outline)
+{
+    if (outline.n_points == 0) return {};
+
+    FT_Outline_Funcs funcs;
+    funcs.move_to = &OutlinePathBuilder::moveTo;
+    funcs.line_to = &OutlinePathBuilder::lineTo;
+    funcs.conic_to = &OutlinePathBuilder::conicTo;
+    funcs.cubic_to = &OutlinePathBuilder::cubicTo;
+    funcs.shift = 0;
+    funcs.delta = 0;
+
+    OutlinePathBuilder builder;
+    FT_Outline copy = outline;
+    {
+        TRACE_SCOPE("freetype", "FT_Outline_Decompose");
+        FT_Outline_Decompose(&copy, &funcs, &builder);
+    }
+    builder.closeContour();
+
+    return std::move(builder.data);
+}
+
+std::shared_ptr<const FaceInfo> makeFaceInfo(FT_Face face, const std::string &path, FT_Long faceIndex)
+{
+    auto info = std::make_shared<FaceInfo>();
+    info->path = path;
+    info->face_index = faceIndex;
+
+    info->bbox                = face->bbox;
+    info->units_per_EM        = face->units_per_EM;
+    info->ascender            = face->ascender;
+    info->descender           = face->descender;
+    info->height              = face->height;
+    info->max_advance_width   = face->max_advance_width;
+    info->max_advance_height  = face->max_advance_height;
+    info->underline_position  = face->underline_position;
+    info->underline_thickness = face->underline_thickness;
+    info->num_fixed_sizes     = face->num_fixed_sizes;
+    info->available_sizes.assign(face->available_sizes, face->available_sizes + face->num_fixed_sizes);
+    info->num_glyphs          = face->num_glyphs;
+
+    return info;
+}
+
+FT_ULong pickDefaultChar(FT_Face face, FT_ULong preferred)
+{
+    // Char picking logic, in order of preference
+    // 1 - preferred (from last font) is available, pick that
+    // 2 - Default char 'A' is available, pick that
+    // 3 - Pick first non-control charcode in the font
+    TRACE_SCOPE("freetype", "pickDefaultChar");
+    if (FT_Get_Char_Index(face, preferred)) return preferred;
+    if (FT_Get_Char_Index(face, 'A')) return 'A';
+
+    FT_UInt gindex;
+    FT_ULong charCode = FT_Get_Next_Char(face, 32, &gindex);
+    if (gindex) return charCode;
+
+    return preferred;
+}
+
+void RenderedGlyph::setBitmap(const FT_Bitmap &source)
+{
+    // Keep the row order of the source, bitmapRow() deals with negative pitch
+    bitmap = source;
+    m_bitmapBuffer.clear();
+    if (source.buffer)
+    {
+        m_bitmapBuffer.assign(source.buffer, source.buffer + (size_t)source.rows * std::abs(source.pitch));
+    }
+    bitmap.buffer = m_bitmapBuffer.data();
+}
+
+std::shared_ptr<RenderedGlyph> copyGlyphSlot(FT_GlyphSlot slot, const RenderRequest &request, std::shared_ptr<const FaceInfo> faceInfo)
+{
+    auto res = std::make_shared<RenderedGlyph>();
+    res->request = request;
+    res->face = std::move(faceInfo);
+
+    res->glyph_index       = slot->glyph_index;
+    res->metrics           = slot->metrics;
+    res->linearHoriAdvance = slot->linearHoriAdvance;
+    res->linearVertAdvance = slot->linearVertAdvance;
+    res->advance           = slot->advance;
+    res->format            = slot->format;
+    res->bitmap_left       = slot->bitmap_left;
+    res->bitmap_top        = slot->bitmap_top;
+    res->lsb_delta         = slot->lsb_delta;
+    res->rsb_delta         = slot->rsb_delta;
+
+    res->setBitmap(slot->bitmap);
+
+    // Outline is still in the slot after rendering, unless it was a bitmap glyph
+    res->outlinePath = decomposeOutline(slot->outline);
+
+    return res;
+}
+
+RenderedGlyphPtr renderGlyph(FT_Face face, const RenderRequest &request, std::shared_ptr<const FaceInfo> faceInfo,
+                             RenderTimings *timings)
+{
+    std::chrono::steady_clock::time_point lap;
+    if (timings) lap = std::chrono::steady_clock::now();
+
+    if (face->num_fixed_sizes)
+    {
+        TRACE_SCOPE("freetype", "FT_Select_Size");
+        FT_Select_Size(face, 0);
+    }
+    else
+    {
+        TRACE_SCOPE("freetype", "FT_Set_Char_Size");
+        FT_Set_Char_Size(face, request.charSize*64, request.charSize*64, 0, 0);
+    }
+
+    {
+        TRACE_SCOPE("freetype", "FT_Set_Transform");
+        FT_Matrix matrix = request.matrix;
+        FT_Vector delta = request.delta;
+        FT_Set_Transform(face, &matrix, &delta);
+    }
+    if (timings) addLapTime(lap, timings->setCharSize);
+
+    FT_Error errorCode;
+    {
+        TRACE_SCOPE("freetype", "FT_Load_Char");
+        errorCode = FT_Load_Char(face, request.charCode, request.loadFlags);
+    }
+    if (errorCode) throw FreetypeError(errorCode, "FT_Load_Char");
+    if (timings) addLapTime(lap, timings->loadChar);
+
+    {
+        TRACE_SCOPE("freetype", "FT_Render_Glyph");
+        errorCode = FT_Render_Glyph(face->glyph, request.renderMode);
+    }
+    if (errorCode)
+    {
+        // On FT-2.11.0, NotoColorEmoji.ttf seems to return error 19, but render fine??, TODO
+        // throw FreetypeError(errorCode, "FT_Render_Glyph");
+        std::cerr << "Failed rendering char " << request.charCode << " error code " << errorCode << "\n";
+    }
+    if (timings) addLapTime(lap, timings->renderGlyph);
+
+    RenderedGlyphPtr res;
+    {
+        TRACE_SCOPE("render", "copyGlyphSlot");
+        res = copyGlyphSlot(face->glyph, request, std::move(faceInfo));
+    }
+    if (timings) addLapTime(lap, timings->copy);
+    return res;
+}
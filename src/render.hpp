@@ -0,0 +1,170 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cairo.h>
+#include <freetype/freetype.h>
+
+std::runtime_error FreetypeError(FT_Error errorCode, const char *method);
+
+struct CharMapEntry
+{
+    FT_ULong charCode;
+    FT_UInt glyphIndex;
+};
+
+// Face wide values, shared by every glyph rendered from the same opened face.
+// Field names follow FT_FaceRec.
+struct FaceInfo
+{
+    std::string path;
+    FT_Long face_index = 0;
+
+    FT_BBox bbox;
+    FT_UShort units_per_EM;
+    FT_Short ascender;
+    FT_Short descender;
+    FT_Short height;
+    FT_Short max_advance_width;
+    FT_Short max_advance_height;
+    FT_Short underline_position;
+    FT_Short underline_thickness;
+    FT_Int num_fixed_sizes;
+    // The num_fixed_sizes bitmap strikes
+    std::vector<FT_Bitmap_Size> available_sizes;
+    FT_Long num_glyphs;
+};
+
+// Consecutive run of a face's charmap, the worker streams the charmap of a
+// newly opened face in these after rendering its first glyph
+struct CharMapChunk
+{
+    std::shared_ptr<const FaceInfo> face;
+    // Walk the chunk belongs to, a new walk starts with every face switch,
+    // also when switching back to a face still in the face cache
+    uint64_t walk = 0;
+    // Sorted by charcode, continuing where the previous chunk left off
+    std::vector<CharMapEntry> entries;
+    // No more chunks follow for this face
+    bool last = false;
+};
+
+// Everything needed to render one glyph. Immutable once posted to a worker.
+struct RenderRequest
+{
+    std::string fontPath;
+    FT_Long faceIndex = 0;
+
+    FT_ULong charCode = 0;
+    int charSize = 13;
+    FT_Int32 loadFlags = 0;
+    FT_Render_Mode renderMode = FT_RENDER_MODE_NORMAL;
+
+    // Passed to FT_Set_Transform
+    FT_Matrix matrix = { 0x10000, 0, 0, 0x10000 };
+    FT_Vector delta = { 0, 0 };
+};
+
+// Time spent in each stage of one request, in milliseconds
+struct RenderTimings
+{
+    // FaceCache::acquire(), opening the face on a miss
+    double faceLookup = 0;
+    // FT_Set_Char_Size, or the FTC size lookup
+    double setCharSize = 0;
+    // FT_Load_Char
+    double loadChar = 0;
+    // FT_Render_Glyph, or the FTC bitmap lookup
+    double renderGlyph = 0;
+    // Copying the slot and decomposing the outline
+    double copy = 0;
+    // Served by the result cache, nothing was rendered
+    bool cached = false;
+};
+
+// Adds the milliseconds since `since` to `ms` and restarts `since`
+inline void addLapTime(std::chrono::steady_clock::time_point &since, double &ms)
+{
+    auto now = std::chrono::steady_clock::now();
+    ms += std::chrono::duration<double, std::milli>(now - since).count();
+    since = now;
+}
+
+// Copy of face->glyph after loading and rendering, owning its bitmap and
+// outline buffers so it can outlive the face and cross threads. Field names
+// follow FT_GlyphSlotRec.
+struct RenderedGlyph
+{
+    RenderedGlyph() = default;
+    RenderedGlyph(const RenderedGlyph&) = delete;
+    RenderedGlyph& operator=(const RenderedGlyph&) = delete;
+
+    RenderRequest request;
+    std::shared_ptr<const FaceInfo> face;
+
+    FT_UInt glyph_index;
+    FT_Glyph_Metrics metrics;
+    FT_Fixed linearHoriAdvance;
+    FT_Fixed linearVertAdvance;
+    FT_Vector advance;
+    FT_Glyph_Format format;
+    FT_Int bitmap_left;
+    FT_Int bitmap_top;
+    FT_Pos lsb_delta;
+    FT_Pos rsb_delta;
+
+    // Buffer refers to the storage below
+    FT_Bitmap bitmap;
+
+    // Decomposed once per glyph, in pixel units with y pointing down and
+    // every contour closed. Empty if the glyph has no outline.
+    std::vector<cairo_path_data_t> outlinePath;
+
+    // Copies the pixels of `source` into storage owned by this glyph
+    void setBitmap(const FT_Bitmap &source);
+
+private:
+    std::vector<unsigned char> m_bitmapBuffer;
+};
+
+using RenderedGlyphPtr = std::shared_ptr<const RenderedGlyph>;
+
+// Converts an FT_Outline to cairo path data, see RenderedGlyph::outlinePath
+std::vector<cairo_path_data_t> decomposeOutline(const FT_Outline &outline);
+
+// Collects face wide values of a newly opened face
+std::shared_ptr<const FaceInfo> makeFaceInfo(FT_Face face, const std::string &path, FT_Long faceIndex);
+
+// Char to show when a face is opened, `preferred` (the char shown for the
+// previous face) if the face maps it
+FT_ULong pickDefaultChar(FT_Face face, FT_ULong preferred);
+
+// Copies the glyph loaded in `slot`, along with its bitmap if it has one
+std::shared_ptr<RenderedGlyph> copyGlyphSlot(FT_GlyphSlot slot, const RenderRequest &request, std::shared_ptr<const FaceInfo> faceInfo);
+
+// Sets size and transform, loads and renders request.charCode on `face`.
+// Stages are timed into `timings` unless it is null.
+RenderedGlyphPtr renderGlyph(FT_Face face, const RenderRequest &request, std::shared_ptr<const FaceInfo> faceInfo,
+                             RenderTimings *timings = nullptr);
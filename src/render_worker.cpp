@@ -0,0 +1,240 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "render_worker.hpp"
+
+#include "trace.hpp"
+
+
+// Charmap entries walked between two checks for a pending request
+static const size_t kCharMapChunkSize = 4096;
+
+RenderWorker::RenderWorker(std::function<void()> notify)
+    : m_notify(std::move(notify))
+    , m_resultCache(defaultResultCacheBudget())
+{
+    if (FT_Init_FreeType(&m_ft)) throw std::runtime_error("FT_Init_FreeType");
+    m_faceCache.emplace(m_ft, defaultFaceCacheBudget());
+    m_glyphCache.emplace(m_ft, defaultGlyphCacheBudget());
+    m_faceCacheStats = m_faceCache->stats();
+    m_glyphCacheStats = m_glyphCache->stats();
+    m_resultCacheStats = m_resultCache.stats();
+    m_thread = std::thread([this]()
+    {
+        setTraceThreadName("render worker");
+        run();
+    });
+}
+
+RenderWorker::~RenderWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    m_glyphCache.reset();
+    m_faceCache.reset();
+    FT_Done_FreeType(m_ft);
+}
+
+void RenderWorker::post(RenderRequest request)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = std::move(request);
+    }
+    m_cond.notify_one();
+}
+
+RenderedGlyphPtr RenderWorker::takeResult()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_error)
+    {
+        std::exception_ptr error = m_error;
+        m_error = nullptr;
+        std::rethrow_exception(error);
+    }
+    return std::move(m_result);
+}
+
+std::optional<FaceSwitch> RenderWorker::takeFaceSwitch()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::optional<FaceSwitch> faceSwitch = std::move(m_faceSwitch);
+    m_faceSwitch.reset();
+    return faceSwitch;
+}
+
+std::vector<CharMapChunk> RenderWorker::takeCharMapChunks()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::move(m_charMapChunks);
+}
+
+FaceCacheStats RenderWorker::faceCacheStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_faceCacheStats;
+}
+
+GlyphCacheStats RenderWorker::glyphCacheStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_glyphCacheStats;
+}
+
+ResultCacheStats RenderWorker::resultCacheStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_resultCacheStats;
+}
+
+void RenderWorker::setTimingEnabled(bool enabled)
+{
+    m_timingEnabled = enabled;
+}
+
+RenderTimings RenderWorker::renderTimings()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_renderTimings;
+}
+
+void RenderWorker::walkCharMapChunk()
+{
+    CharMapChunk chunk;
+    chunk.face = m_faceInfo;
+    chunk.walk = m_walk;
+    chunk.entries.reserve(kCharMapChunkSize);
+
+    // One event per chunk, FT_Get_Next_Char is too quick to trace per call
+    TRACE_SCOPE("freetype", "FT_Get_Next_Char chunk");
+    while (m_walkGlyphIndex != 0 && chunk.entries.size() < kCharMapChunkSize)
+    {
+        chunk.entries.push_back({ m_walkCharCode, m_walkGlyphIndex });
+        m_walkCharCode = FT_Get_Next_Char(m_face, m_walkCharCode, &m_walkGlyphIndex);
+    }
+    chunk.last = (m_walkGlyphIndex == 0);
+    m_walkingCharMap = !chunk.last;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_charMapChunks.push_back(std::move(chunk));
+    }
+    m_notify();
+}
+
+void RenderWorker::run()
+{
+    while (true)
+    {
+        RenderRequest request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return m_stop || m_pending || m_walkingCharMap; });
+            if (m_stop) return;
+
+            // Requests take priority, the charmap is walked while there are none
+            if (!m_pending)
+            {
+                lock.unlock();
+                walkCharMapChunk();
+                continue;
+            }
+
+            request = std::move(*m_pending);
+            m_pending.reset();
+        }
+
+        TRACE_SCOPE("render", "render request");
+
+        RenderedGlyphPtr result;
+        std::exception_ptr error;
+        std::optional<FaceSwitch> faceSwitch;
+        RenderTimings timingsStorage;
+        RenderTimings *timings = m_timingEnabled ? &timingsStorage : nullptr;
+        try
+        {
+            std::chrono::steady_clock::time_point lap;
+            if (timings) lap = std::chrono::steady_clock::now();
+
+            // Looked up for every request so a font changed on disk is reopened
+            FaceCache::Face face = m_faceCache->acquire(request.fontPath, request.faceIndex);
+            if (timings) addLapTime(lap, timings->faceLookup);
+            if (face.info != m_faceInfo)
+            {
+                m_face = face.face;
+                m_faceInfo = face.info;
+
+                // The glyph list is rebuilt for every switch, cached faces included
+                {
+                    TRACE_SCOPE("freetype", "FT_Get_First_Char");
+                    m_walkCharCode = FT_Get_First_Char(m_face, &m_walkGlyphIndex);
+                }
+                m_walkingCharMap = true;
+
+                // The char shown for the previous face may be missing from this one
+                request.charCode = pickDefaultChar(m_face, request.charCode);
+                ++m_walk;
+                faceSwitch = FaceSwitch{ m_faceInfo, request.charCode, m_walk };
+            }
+
+            {
+                TRACE_SCOPE("render", "ResultCache::find");
+                result = m_resultCache.find(request, m_faceInfo.get());
+            }
+            if (!result)
+            {
+                result = m_glyphCache->render(request, m_faceInfo, timings);
+                if (!result)
+                {
+                    result = renderGlyph(m_face, request, m_faceInfo, timings);
+                }
+                m_resultCache.insert(result);
+            }
+            else if (timings)
+            {
+                timings->cached = true;
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_result = std::move(result);
+            m_error = error;
+            if (faceSwitch)
+            {
+                m_faceSwitch = std::move(faceSwitch);
+                // Chunks of the previous walk are stale, even if it was on the same face
+                m_charMapChunks.clear();
+            }
+            m_faceCacheStats = m_faceCache->stats();
+            m_glyphCacheStats = m_glyphCache->stats();
+            m_resultCacheStats = m_resultCache.stats();
+            m_renderTimings = timingsStorage;
+        }
+        m_notify();
+    }
+}
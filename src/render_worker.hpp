@@ -0,0 +1,120 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "face_cache.hpp"
+#include "glyph_cache.hpp"
+#include "render.hpp"
+#include "result_cache.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Face a request switched the worker to, along with the char shown for it
+struct FaceSwitch
+{
+    std::shared_ptr<const FaceInfo> face;
+    FT_ULong charCode = 0;
+    // Charmap walk started for the face, see CharMapChunk::walk
+    uint64_t walk = 0;
+};
+
+// Renders glyphs on a background thread with its own FT_Library and FT_Face.
+//
+// Only the latest request matters: posting replaces a request that has not
+// started yet, and a finished result replaces one that was not taken yet.
+//
+// Recently used faces stay open in a FaceCache, so switching back to one is
+// cheap. When a request switches faces, the worker renders it first and then walks the
+// face's charmap in chunks between requests.
+class RenderWorker
+{
+public:
+    // `notify` is called on the worker thread each time a result is ready
+    explicit RenderWorker(std::function<void()> notify);
+    ~RenderWorker();
+
+    RenderWorker(const RenderWorker&) = delete;
+    RenderWorker& operator=(const RenderWorker&) = delete;
+
+    void post(RenderRequest request);
+
+    // Latest finished glyph, nullptr if there is nothing new.
+    // Rethrows the error if the latest request failed.
+    RenderedGlyphPtr takeResult();
+
+    // Latest face switch not taken yet. Reported even when rendering on the
+    // new face fails, its charmap chunks follow it.
+    std::optional<FaceSwitch> takeFaceSwitch();
+
+    // Charmap chunks produced since the last call, oldest first
+    std::vector<CharMapChunk> takeCharMapChunks();
+
+    // Cache counters as of the latest request
+    FaceCacheStats faceCacheStats();
+    GlyphCacheStats glyphCacheStats();
+    ResultCacheStats resultCacheStats();
+
+    // Stage timings are only measured while enabled
+    void setTimingEnabled(bool enabled);
+    // Stages of the latest request, zero unless timing is enabled
+    RenderTimings renderTimings();
+
+private:
+    void run();
+    void walkCharMapChunk();
+
+    std::function<void()> m_notify;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop = false;
+    std::optional<RenderRequest> m_pending;
+    RenderedGlyphPtr m_result;
+    std::exception_ptr m_error;
+    std::optional<FaceSwitch> m_faceSwitch;
+    std::vector<CharMapChunk> m_charMapChunks;
+    FaceCacheStats m_faceCacheStats;
+    GlyphCacheStats m_glyphCacheStats;
+    ResultCacheStats m_resultCacheStats;
+    RenderTimings m_renderTimings;
+    std::atomic<bool> m_timingEnabled{false};
+
+    // Only touched by the worker thread
+    FT_Library m_ft = nullptr;
+    // Closed before m_ft is
+    std::optional<FaceCache> m_faceCache;
+    std::optional<GlyphCache> m_glyphCache;
+    ResultCache m_resultCache;
+    FT_Face m_face = nullptr;
+    std::shared_ptr<const FaceInfo> m_faceInfo;
+
+    // Position of the charmap walk, m_walkGlyphIndex is 0 when done
+    uint64_t m_walk = 0;
+    bool m_walkingCharMap = false;
+    FT_ULong m_walkCharCode = 0;
+    FT_UInt m_walkGlyphIndex = 0;
+
+    std::thread m_thread;
+};
@@ -0,0 +1,86 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "result_cache.hpp"
+
+#include <cstdlib>
+#include <tuple>
+
+size_t defaultResultCacheBudget()
+{
+    size_t megabytes = 64;
+    if (const char *env = getenv("FONTDEBUG_RESULT_CACHE_MB"))
+    {
+        megabytes = strtoull(env, nullptr, 10);
+    }
+    return megabytes << 20;
+}
+
+bool ResultCache::Key::operator<(const Key &o) const
+{
+    return std::tie(face, charCode, charSize, loadFlags, renderMode, matrix.xx, matrix.xy, matrix.yx, matrix.yy, delta.x, delta.y) <
+        std::tie(o.face, o.charCode, o.charSize, o.loadFlags, o.renderMode, o.matrix.xx, o.matrix.xy, o.matrix.yx, o.matrix.yy, o.delta.x, o.delta.y);
+}
+
+ResultCache::Key ResultCache::makeKey(const RenderRequest &request, const FaceInfo *face)
+{
+    return { face, request.charCode, request.charSize, request.loadFlags, request.renderMode, request.matrix, request.delta };
+}
+
+ResultCache::ResultCache(size_t budget)
+{
+    m_stats.budget = budget;
+}
+
+RenderedGlyphPtr ResultCache::find(const RenderRequest &request, const FaceInfo *face)
+{
+    auto it = m_index.find(makeKey(request, face));
+    if (it == m_index.end())
+    {
+        ++m_stats.misses;
+        return nullptr;
+    }
+
+    ++m_stats.hits;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->glyph;
+}
+
+void ResultCache::insert(RenderedGlyphPtr glyph)
+{
+    Key key = makeKey(glyph->request, glyph->face.get());
+    if (m_index.count(key)) return;
+
+    size_t bytes = sizeof(RenderedGlyph)
+        + (size_t)glyph->bitmap.rows * std::abs(glyph->bitmap.pitch)
+        + glyph->outlinePath.size() * sizeof(cairo_path_data_t);
+
+    m_entries.push_front({ key, std::move(glyph), bytes });
+    m_index.emplace(key, m_entries.begin());
+    m_stats.bytes += bytes;
+    ++m_stats.entries;
+
+    // The newest entry stays even alone over budget, the caller holds it anyway
+    while (m_stats.bytes > m_stats.budget && m_entries.size() > 1)
+    {
+        const Entry &victim = m_entries.back();
+        m_stats.bytes -= victim.bytes;
+        --m_stats.entries;
+        m_index.erase(victim.key);
+        m_entries.pop_back();
+    }
+}
@@ -0,0 +1,81 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "render.hpp"
+
+#include <cstdint>
+#include <list>
+#include <map>
+
+struct ResultCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t entries = 0;
+    // Approximate size of the cached glyphs, charged against `budget`
+    size_t bytes = 0;
+    size_t budget = 0;
+};
+
+// Memory budget from FONTDEBUG_RESULT_CACHE_MB, 64 MiB by default
+size_t defaultResultCacheBudget();
+
+// Finished glyphs by the full render state, so returning to a state seen
+// before (toggling a render mode back, undoing a rotation) needs no FreeType
+// calls at all. Glyphs hold their FaceInfo, so a face reopened after the file
+// changed never matches the old entries. Least recently used glyphs are
+// dropped past the budget. Not thread safe.
+class ResultCache
+{
+public:
+    explicit ResultCache(size_t budget);
+
+    // Glyph rendered earlier for `request` on `face`, nullptr if there is none
+    RenderedGlyphPtr find(const RenderRequest &request, const FaceInfo *face);
+    void insert(RenderedGlyphPtr glyph);
+
+    const ResultCacheStats& stats() const { return m_stats; }
+
+private:
+    struct Key
+    {
+        const FaceInfo *face;
+        FT_ULong charCode;
+        int charSize;
+        FT_Int32 loadFlags;
+        FT_Render_Mode renderMode;
+        FT_Matrix matrix;
+        FT_Vector delta;
+
+        bool operator<(const Key &o) const;
+    };
+    static Key makeKey(const RenderRequest &request, const FaceInfo *face);
+
+    struct Entry
+    {
+        Key key;
+        RenderedGlyphPtr glyph;
+        size_t bytes;
+    };
+
+    // Most recently used first
+    std::list<Entry> m_entries;
+    std::map<Key, std::list<Entry>::iterator> m_index;
+    ResultCacheStats m_stats;
+};
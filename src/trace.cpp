@@ -0,0 +1,180 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "trace.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+// Events kept per thread, about 2.5 MiB
+const size_t kTraceBufferSize = 1 << 16;
+
+// One event, written by the owning thread while the exporter may read it.
+// `seq` is odd while a write is in progress, a seqlock.
+struct TraceSlot
+{
+    std::atomic<uint64_t> seq{0};
+    std::atomic<const char*> category{nullptr};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<int64_t> start{0};
+    std::atomic<int64_t> end{0};
+};
+
+struct TraceBuffer
+{
+    int tid = 0;
+    std::string threadName;
+    // Only written by the owning thread
+    std::atomic<uint64_t> next{0};
+    std::unique_ptr<TraceSlot[]> slots{new TraceSlot[kTraceBufferSize]};
+};
+
+struct TraceEvent
+{
+    const char *category;
+    const char *name;
+    int64_t start;
+    int64_t end;
+};
+
+// Buffers outlive their threads so a trace still shows threads that exited
+std::mutex g_buffersMutex;
+std::vector<std::shared_ptr<TraceBuffer>> g_buffers;
+std::atomic<int64_t> g_recordingStart{0};
+
+thread_local const char *t_threadName = nullptr;
+thread_local std::shared_ptr<TraceBuffer> t_buffer;
+
+TraceBuffer& threadBuffer()
+{
+    if (!t_buffer)
+    {
+        auto buffer = std::make_shared<TraceBuffer>();
+        std::lock_guard<std::mutex> lock(g_buffersMutex);
+        buffer->tid = g_buffers.size() + 1;
+        buffer->threadName = t_threadName ? t_threadName : "thread " + std::to_string(buffer->tid);
+        g_buffers.push_back(buffer);
+        t_buffer = std::move(buffer);
+    }
+    return *t_buffer;
+}
+
+// Events of `buffer` still in the ring, skipping ones overwritten while reading
+void readEvents(const TraceBuffer &buffer, int64_t since, std::vector<TraceEvent> &events)
+{
+    uint64_t end = buffer.next.load(std::memory_order_acquire);
+    uint64_t begin = end > kTraceBufferSize ? end - kTraceBufferSize : 0;
+
+    for (uint64_t i = begin; i < end; ++i)
+    {
+        const TraceSlot &slot = buffer.slots[i % kTraceBufferSize];
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq != 2 * i + 2) continue;
+
+        TraceEvent event = {
+            slot.category.load(std::memory_order_relaxed),
+            slot.name.load(std::memory_order_relaxed),
+            slot.start.load(std::memory_order_relaxed),
+            slot.end.load(std::memory_order_relaxed),
+        };
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+
+        if (event.start >= since) events.push_back(event);
+    }
+}
+
+}
+
+void setTraceEnabled(bool enabled)
+{
+    if (enabled) g_recordingStart = traceNow();
+    g_traceEnabled = enabled;
+}
+
+void setTraceThreadName(const char *name)
+{
+    t_threadName = name;
+}
+
+void recordTraceEvent(const char *category, const char *name, int64_t start, int64_t end)
+{
+    TraceBuffer &buffer = threadBuffer();
+    uint64_t i = buffer.next.load(std::memory_order_relaxed);
+    TraceSlot &slot = buffer.slots[i % kTraceBufferSize];
+
+    slot.seq.store(2 * i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    slot.seq.store(2 * i + 2, std::memory_order_release);
+
+    buffer.next.store(i + 1, std::memory_order_release);
+}
+
+void writeTrace(const std::string &path)
+{
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(g_buffersMutex);
+        buffers = g_buffers;
+    }
+    int64_t since = g_recordingStart;
+
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f) throw std::runtime_error(path + ": fopen: " + strerror(errno));
+
+    int pid = getpid();
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"fontdebug\"}}", pid);
+
+    std::vector<TraceEvent> events;
+    events.reserve(kTraceBufferSize);
+    for (const auto &buffer : buffers)
+    {
+        // Thread names are ours, nothing in them needs escaping
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                pid, buffer->tid, buffer->threadName.c_str());
+
+        events.clear();
+        readEvents(*buffer, since, events);
+        for (const TraceEvent &event : events)
+        {
+            // Microseconds since the recording started
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                    event.name, event.category, (event.start - since) / 1000.0, (event.end - event.start) / 1000.0,
+                    pid, buffer->tid);
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+    bool failed = ferror(f);
+    if (fclose(f) != 0 || failed) throw std::runtime_error(path + ": write failed");
+}
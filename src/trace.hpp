@@ -0,0 +1,91 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Scoped events for Chrome's trace viewer and Perfetto.
+//
+// Each thread records into its own fixed size ring buffer, the oldest
+// events are overwritten once it is full. Recording takes no locks, and
+// while tracing is disabled a scope costs one relaxed load. Category and
+// name must be string literals, only the pointers are stored.
+
+// Starts or stops recording. Starting drops the events of earlier recordings
+// from the next writeTrace().
+void setTraceEnabled(bool enabled);
+
+inline std::atomic<bool> g_traceEnabled{false};
+
+inline bool traceEnabled()
+{
+    return g_traceEnabled.load(std::memory_order_relaxed);
+}
+
+// Name of the calling thread in the trace, call before its first event
+void setTraceThreadName(const char *name);
+
+// Writes the events of the current recording, from every thread, as Chrome
+// trace-event JSON. Can be called while recording.
+void writeTrace(const std::string &path);
+
+// Nanoseconds on the steady clock
+inline int64_t traceNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void recordTraceEvent(const char *category, const char *name, int64_t start, int64_t end);
+
+class TraceScope
+{
+public:
+    TraceScope(const char *category, const char *name)
+    {
+        if (traceEnabled())
+        {
+            m_category = category;
+            m_name = name;
+            m_start = traceNow();
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (m_name) recordTraceEvent(m_category, m_name, m_start, traceNow());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char *m_category = nullptr;
+    const char *m_name = nullptr;
+    int64_t m_start = 0;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Records the rest of the enclosing block as one event
+#define TRACE_SCOPE(category, name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(category, name)
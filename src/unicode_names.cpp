@@ -0,0 +1,92 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "unicode_names.hpp"
+
+#include <array>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unicode/uchar.h>
+
+namespace {
+
+// Codepoint -> pooled name, one lazily allocated page per 256 codepoints
+class NameCache
+{
+public:
+    const char* get(uint32_t charCode)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto &page = m_pages[charCode >> 8];
+        if (!page)
+        {
+            page = std::make_unique<Page>();
+            page->fill(nullptr);
+        }
+
+        const char *&name = (*page)[charCode & 0xff];
+        if (!name)
+        {
+            char charNameBuf[100];
+            UErrorCode errorCode = U_ZERO_ERROR;
+            u_charName(charCode, U_EXTENDED_CHAR_NAME, charNameBuf, sizeof(charNameBuf), &errorCode);
+            name = U_SUCCESS(errorCode) ? intern(charNameBuf) : "";
+        }
+        return name;
+    }
+
+private:
+    using Page = std::array<const char*, 256>;
+
+    // Copies `str` into the pool. Blocks are never moved or freed, so the
+    // returned pointers stay valid for the life of the process.
+    const char* intern(const char *str)
+    {
+        size_t size = strlen(str) + 1;
+        if (m_blocks.empty() || m_blockUsed + size > kBlockSize)
+        {
+            m_blocks.push_back(std::make_unique<char[]>(kBlockSize));
+            m_blockUsed = 0;
+        }
+
+        char *dst = m_blocks.back().get() + m_blockUsed;
+        memcpy(dst, str, size);
+        m_blockUsed += size;
+        return dst;
+    }
+
+    static const size_t kBlockSize = 64 * 1024;
+
+    std::mutex m_mutex;
+    std::array<std::unique_ptr<Page>, ((UCHAR_MAX_VALUE + 1) >> 8)> m_pages;
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    size_t m_blockUsed = 0;
+};
+
+} // namespace
+
+const char* unicodeCharName(uint32_t charCode)
+{
+    static NameCache cache;
+
+    if (charCode > UCHAR_MAX_VALUE) return "";
+    return cache.get(charCode);
+}
@@ -0,0 +1,186 @@
+// Copyright 2021 Mustafa Serdar Sanli
+//
+// This file is part of FontDebug.
+//
+// FontDebug is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// FontDebug is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FontDebug.  If not, see <https://www.gnu.org/licenses/>.
+
+
+// Checks the SIMD bitmap conversion kernels against the scalar reference
+
+#include "bitmap_convert.hpp"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+struct TestBitmap
+{
+    std::vector<uint8_t> storage;
+    FT_Bitmap bitmap = {};
+};
+
+// Random bitmap with padded rows, pitch is negated when `negativePitch` is set
+TestBitmap makeBitmap(unsigned char pixelMode, int width, int rows, bool negativePitch, std::mt19937 &rng)
+{
+    int rowBytes = width;
+    if (pixelMode == FT_PIXEL_MODE_MONO) rowBytes = (width + 7) / 8;
+    if (pixelMode == FT_PIXEL_MODE_BGRA) rowBytes = width * 4;
+
+    // Padding catches kernels that read or write past the row
+    int pitch = rowBytes + 5;
+
+    TestBitmap t;
+    t.storage.resize((size_t)pitch * rows);
+    for (uint8_t &b : t.storage)
+    {
+        b = rng();
+    }
+
+    t.bitmap.width = width;
+    t.bitmap.rows = rows;
+    t.bitmap.pitch = negativePitch ? -pitch : pitch;
+    t.bitmap.buffer = t.storage.data();
+    t.bitmap.pixel_mode = pixelMode;
+    t.bitmap.num_grays = pixelMode == FT_PIXEL_MODE_MONO ? 2 : 256;
+    return t;
+}
+
+std::vector<uint32_t> convert(const FT_Bitmap &bitmap, bool grayscaleLCD, BitmapConvertImpl impl)
+{
+    // One spare pixel per row, which must be left alone
+    int stride = bitmap.width + 1;
+    std::vector<uint32_t> out((size_t)stride * bitmap.rows, 0xdeadbeef);
+    convertBitmap(bitmap, grayscaleLCD, out.data(), stride * sizeof(uint32_t), impl);
+    return out;
+}
+
+const char* modeName(unsigned char pixelMode)
+{
+    switch (pixelMode)
+    {
+    case FT_PIXEL_MODE_MONO:  return "MONO";
+    case FT_PIXEL_MODE_GRAY:  return "GRAY";
+    case FT_PIXEL_MODE_LCD:   return "LCD";
+    case FT_PIXEL_MODE_LCD_V: return "LCD_V";
+    case FT_PIXEL_MODE_BGRA:  return "BGRA";
+    default:                  return "?";
+    }
+}
+
+void compareWithScalar(BitmapConvertImpl impl, unsigned char pixelMode, bool grayscaleLCD, std::mt19937 &rng)
+{
+    const int widths[] = { 1, 2, 3, 5, 7, 9, 15, 17, 31, 33, 47, 63, 65, 127, 129, 255 };
+
+    for (int width : widths)
+    {
+        for (bool negativePitch : { false, true })
+        {
+            // LCD_V bitmaps have three rows per pixel
+            int rows = pixelMode == FT_PIXEL_MODE_LCD_V ? 9 : 5;
+            TestBitmap t = makeBitmap(pixelMode, width, rows, negativePitch, rng);
+
+            std::vector<uint32_t> expected = convert(t.bitmap, grayscaleLCD, BitmapConvertImpl::Scalar);
+            std::vector<uint32_t> actual = convert(t.bitmap, grayscaleLCD, impl);
+
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                if (actual[i] != expected[i])
+                {
+                    printf("FAIL %s %s%s width %d%s: pixel %zu is %08x, scalar gives %08x\n",
+                           bitmapConvertImplName(impl), modeName(pixelMode), grayscaleLCD ? " grayscale" : "",
+                           width, negativePitch ? " negative pitch" : "", i, actual[i], expected[i]);
+                    ++g_failures;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// A few hand checked pixels, so the scalar reference is not just trusted
+void checkScalar()
+{
+    uint8_t gray[] = { 0x00, 0x80, 0xff };
+    FT_Bitmap bitmap = {};
+    bitmap.width = 3;
+    bitmap.rows = 1;
+    bitmap.pitch = 3;
+    bitmap.buffer = gray;
+    bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+
+    uint32_t out[3];
+    convertBitmap(bitmap, false, out, sizeof(out), BitmapConvertImpl::Scalar);
+    if (out[0] != 0xff000000 || out[1] != 0xff808080 || out[2] != 0xffffffff)
+    {
+        printf("FAIL Scalar GRAY: %08x %08x %08x\n", out[0], out[1], out[2]);
+        ++g_failures;
+    }
+
+    bitmap.pixel_mode = FT_PIXEL_MODE_LCD;
+    convertBitmap(bitmap, false, out, sizeof(out), BitmapConvertImpl::Scalar);
+    if (out[0] != 0xff000000 || out[1] != 0xff008000 || out[2] != 0xff0000ff)
+    {
+        printf("FAIL Scalar LCD: %08x %08x %08x\n", out[0], out[1], out[2]);
+        ++g_failures;
+    }
+
+    uint8_t mono[] = { 0xa0 };
+    bitmap.buffer = mono;
+    bitmap.pitch = 1;
+    bitmap.pixel_mode = FT_PIXEL_MODE_MONO;
+    convertBitmap(bitmap, false, out, sizeof(out), BitmapConvertImpl::Scalar);
+    if (out[0] != 0xffffffff || out[1] != 0xff000000 || out[2] != 0xffffffff)
+    {
+        printf("FAIL Scalar MONO: %08x %08x %08x\n", out[0], out[1], out[2]);
+        ++g_failures;
+    }
+}
+
+}
+
+int main()
+{
+    std::mt19937 rng(12345);
+
+    checkScalar();
+
+    for (BitmapConvertImpl impl : { BitmapConvertImpl::SSE2, BitmapConvertImpl::AVX2 })
+    {
+        if (!bitmapConvertImplSupported(impl))
+        {
+            printf("SKIP %s, not supported by this CPU\n", bitmapConvertImplName(impl));
+            continue;
+        }
+
+        compareWithScalar(impl, FT_PIXEL_MODE_MONO, false, rng);
+        compareWithScalar(impl, FT_PIXEL_MODE_GRAY, false, rng);
+        compareWithScalar(impl, FT_PIXEL_MODE_LCD, false, rng);
+        compareWithScalar(impl, FT_PIXEL_MODE_LCD, true, rng);
+        compareWithScalar(impl, FT_PIXEL_MODE_LCD_V, false, rng);
+        compareWithScalar(impl, FT_PIXEL_MODE_LCD_V, true, rng);
+        compareWithScalar(impl, FT_PIXEL_MODE_BGRA, false, rng);
+    }
+
+    if (g_failures)
+    {
+        printf("%d failures\n", g_failures);
+        return 1;
+    }
+    printf("All bitmap conversions match the scalar reference\n");
+    return 0;
+}